@@ -0,0 +1,270 @@
+/*
+  ==============================================================================
+    BeatDetector.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "BeatDetector.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    //tempos considered, wide enough for most dance music without doubling or halving
+    const double minBpm = 70.0;
+    const double maxBpm = 180.0;
+    const double centreBpm = 128.0;
+
+    //shortest track that can be given a grid
+    const double minSeconds = 10.0;
+
+    //frames used for the autocorrelation, about 12 minutes at 44.1 kHz
+    const int maxAutocorrelationFrames = 65536;
+
+    /**Value of the envelope at a fractional frame, interpolated, or 0 past either end*/
+    float interpolate(const std::vector<float>& values, double position)
+    {
+        const int index = (int)position;
+        if (position < 0.0 || index + 1 >= (int)values.size())
+        {
+            return 0.0f;
+        }
+        const float fraction = (float)(position - index);
+        return values[(size_t)index] + (values[(size_t)index + 1] - values[(size_t)index]) * fraction;
+    }
+
+    /**Remove the local average and keep what rises above it, so steady loudness does not count as onsets*/
+    void keepPeaks(std::vector<float>& values, int radius)
+    {
+        std::vector<double> sums(values.size() + 1, 0.0);
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            sums[i + 1] = sums[i] + values[i];
+        }
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            const size_t start = (size_t)jmax(0, (int)i - radius);
+            const size_t end = jmin(values.size(), i + (size_t)radius + 1);
+            const double average = (sums[end] - sums[start]) / (double)(end - start);
+            values[i] = jmax(0.0f, (float)(values[i] - average));
+        }
+    }
+}
+
+BeatDetector::BeatDetector(double _sampleRate)
+    : sampleRate(_sampleRate),
+      //about 23 ms frames whatever the sample rate
+      fftOrder(_sampleRate > 64000.0 ? 11 : 10),
+      fftSize(1 << fftOrder),
+      hopSize(fftSize / 2),
+      lowEndBins(jmax(2, (int)(150.0 * fftSize / _sampleRate))),
+      fft(fftOrder)
+{
+    window.allocate((size_t)fftSize, false);
+    for (int i = 0; i < fftSize; ++i)
+    {
+        window[i] = 0.5f - 0.5f * std::cos(MathConstants<float>::twoPi * i / fftSize);
+    }
+    fftData.allocate((size_t)fftSize * 2, true);
+    previousSpectrum.allocate((size_t)fftSize / 2 + 1, true);
+    frameInput.allocate((size_t)fftSize, true);
+}
+
+BeatDetector::~BeatDetector()
+{}
+
+//==============================================================================
+void BeatDetector::process(const float* samples, int numSamples)
+{
+    while (numSamples > 0)
+    {
+        const int numToCopy = jmin(numSamples, fftSize - frameFill);
+        std::memcpy(frameInput + frameFill, samples, sizeof(float) * (size_t)numToCopy);
+        frameFill += numToCopy;
+        samples += numToCopy;
+        numSamples -= numToCopy;
+
+        if (frameFill == fftSize)
+        {
+            analyseFrame();
+            std::memmove(frameInput.get(), frameInput + hopSize, sizeof(float) * (size_t)(fftSize - hopSize));
+            frameFill = fftSize - hopSize;
+        }
+    }
+}
+
+bool BeatDetector::finish()
+{
+    const double frameRate = sampleRate / hopSize;
+    if (onsets.size() < (size_t)(minSeconds * frameRate))
+    {
+        return false;
+    }
+
+    //quarter of a second either side is longer than a beat's onset, shorter than a change in section
+    keepPeaks(onsets, roundToInt(frameRate * 0.25));
+    keepPeaks(lowOnsets, roundToInt(frameRate * 0.25));
+
+    //autocorrelation from the power spectrum, padded so the correlation does not wrap around
+    const int numFrames = jmin((int)onsets.size(), maxAutocorrelationFrames);
+    int order = 1;
+    while ((1 << order) < numFrames * 2)
+    {
+        ++order;
+    }
+    const int size = 1 << order;
+    dsp::FFT autocorrelationFft(order);
+    HeapBlock<float> correlation((size_t)size * 2, true);
+    std::memcpy(correlation.get(), onsets.data(), sizeof(float) * (size_t)numFrames);
+
+    autocorrelationFft.performRealOnlyForwardTransform(correlation);
+    for (int i = 0; i < size; ++i)
+    {
+        const float re = correlation[i * 2];
+        const float im = correlation[i * 2 + 1];
+        correlation[i * 2] = re * re + im * im;
+        correlation[i * 2 + 1] = 0.0f;
+    }
+    autocorrelationFft.performRealOnlyInverseTransform(correlation);
+
+    if (correlation[0] <= 0.0f)
+    {
+        return false;
+    }
+
+    //a beat period that is not a whole number of frames splits its peak across neighbouring lags,
+    //while its multiples may fall on a whole number, so the peaks are smoothed a couple of lags wide
+    std::vector<float> autocorrelation((size_t)numFrames, 0.0f);
+    for (int lag = 2; lag < numFrames - 2; ++lag)
+    {
+        autocorrelation[(size_t)lag] = (correlation[lag - 2] + correlation[lag + 2]
+            + 4.0f * (correlation[lag - 1] + correlation[lag + 1])
+            + 6.0f * correlation[lag]) / 16.0f;
+    }
+
+    //coarse tempo. Every multiple of the beat correlates as well as the beat itself, so a gentle
+    //preference for tempos near the middle of dance music picks between doubling and halving
+    double bestBpm = 0.0;
+    double bestScore = 0.0;
+    for (double candidate = minBpm; candidate < maxBpm; candidate += 0.5)
+    {
+        const double lag = 60.0 * frameRate / candidate;
+        const double octavesFromCentre = std::log2(candidate / centreBpm);
+        const double score = interpolate(autocorrelation, lag)
+            * std::exp(-0.5 * octavesFromCentre * octavesFromCentre);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestBpm = candidate;
+        }
+    }
+    if (bestBpm == 0.0)
+    {
+        return false;
+    }
+
+    //refine the tempo together with the phase of the beats over the whole track, within a couple
+    //of percent to a tenth of a beat per minute, then around that to a hundredth
+    double bestPeriod = 60.0 * frameRate / bestBpm;
+    double bestPhase = 0.0;
+    bestScore = 0.0;
+    const double searchWidths[] = { bestBpm * 0.02, 0.15 };
+    const double searchSteps[] = { 0.1, 0.01 };
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        const double centre = 60.0 * frameRate / bestPeriod;
+        for (double candidate = centre - searchWidths[pass]; candidate <= centre + searchWidths[pass]; candidate += searchSteps[pass])
+        {
+            const double period = 60.0 * frameRate / candidate;
+            for (double phase = 0.0; phase < period; phase += 0.5)
+            {
+                const double score = combSum(onsets, period, phase);
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestPeriod = period;
+                    bestPhase = phase;
+                }
+            }
+        }
+    }
+
+    //off-beat hi-hats can line up as well as the beats, but the kicks are on the beat
+    const double offBeatPhase = bestPhase < bestPeriod / 2.0 ? bestPhase + bestPeriod / 2.0 : bestPhase - bestPeriod / 2.0;
+    if (combSum(lowOnsets, bestPeriod, offBeatPhase) > combSum(lowOnsets, bestPeriod, bestPhase))
+    {
+        bestPhase = offBeatPhase;
+    }
+
+    //the downbeat is the beat of the bar with the most low end, counting bars of four from the first beat
+    int downbeat = 0;
+    double bestLowEnd = -1.0;
+    for (int beat = 0; beat < 4; ++beat)
+    {
+        const double lowEnd = combSum(lowOnsets, bestPeriod * 4.0, bestPhase + bestPeriod * beat);
+        if (lowEnd > bestLowEnd)
+        {
+            bestLowEnd = lowEnd;
+            downbeat = beat;
+        }
+    }
+
+    bpm = std::round(60.0 * frameRate / bestPeriod * 100.0) / 100.0;
+
+    //a frame's flux is strongest when the onset reaches the middle of the frame
+    const double firstDownbeatFrame = bestPhase + bestPeriod * downbeat;
+    firstBeatSeconds = (firstDownbeatFrame * hopSize + fftSize / 2) / sampleRate;
+    return true;
+}
+
+double BeatDetector::getBpm() const
+{
+    return bpm;
+}
+
+double BeatDetector::getFirstBeatSeconds() const
+{
+    return firstBeatSeconds;
+}
+
+//==============================================================================
+void BeatDetector::analyseFrame()
+{
+    for (int i = 0; i < fftSize; ++i)
+    {
+        fftData[i] = frameInput[i] * window[i];
+    }
+    FloatVectorOperations::clear(fftData + fftSize, fftSize);
+    fft.performFrequencyOnlyForwardTransform(fftData);
+
+    //log compression, so quiet hi-hats count as well as loud kicks
+    float flux = 0.0f;
+    float lowFlux = 0.0f;
+    for (int bin = 1; bin <= fftSize / 2; ++bin)
+    {
+        const float magnitude = std::log1p(100.0f * fftData[bin]);
+        const float rise = jmax(0.0f, magnitude - previousSpectrum[bin]);
+        flux += rise;
+        if (bin <= lowEndBins)
+        {
+            lowFlux += rise;
+        }
+        previousSpectrum[bin] = magnitude;
+    }
+
+    onsets.push_back(flux);
+    lowOnsets.push_back(lowFlux);
+}
+
+double BeatDetector::combSum(const std::vector<float>& onsets, double period, double phase)
+{
+    double sum = 0.0;
+    int numBeats = 0;
+    for (double position = phase; position < (double)onsets.size(); position += period)
+    {
+        sum += interpolate(onsets, position);
+        ++numBeats;
+    }
+    return numBeats > 0 ? sum / numBeats : 0.0;
+}
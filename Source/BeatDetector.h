@@ -0,0 +1,73 @@
+/*
+  ==============================================================================
+    BeatDetector.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+//===============================================================================
+/*
+    Finds the tempo and beat grid of a track from its audio, fed a chunk at a time.
+    Each frame's spectral flux (the rise in energy across the spectrum) gives an onset
+    strength. The autocorrelation of the onset strengths, taken with an FFT, picks the beat
+    period, which is then refined together with the phase of the beats by summing the onset
+    strengths a beat apart. The downbeat is the beat of each bar with the most low end.
+    Only the onset strengths are kept, a few hundred bytes per second of audio.
+*/
+class BeatDetector
+{
+public:
+
+    BeatDetector(double sampleRate);
+    ~BeatDetector();
+
+    //==============================================================================
+    /**Feed the next mono samples of the track*/
+    void process(const float* samples, int numSamples);
+
+    /**Work out the tempo and grid from everything processed so far.
+    Returns false if the track is too short or has no steady beat*/
+    bool finish();
+
+    /**Tempo in beats per minute, once finish has succeeded*/
+    double getBpm() const;
+    /**Time of the first downbeat in the track, in seconds, once finish has succeeded*/
+    double getFirstBeatSeconds() const;
+
+private:
+    //==============================================================================
+    /**Add the onset strengths of the frame waiting in the input buffer*/
+    void analyseFrame();
+    /**Sum of the onset strengths at every beat for the period and phase, in frames, divided by the number of beats*/
+    static double combSum(const std::vector<float>& onsets, double period, double phase);
+
+    double sampleRate;
+    int fftOrder;
+    int fftSize;
+    int hopSize;
+    //highest bin counted as low end for finding the downbeat
+    int lowEndBins;
+
+    dsp::FFT fft;
+    HeapBlock<float> window;
+    HeapBlock<float> fftData;
+    HeapBlock<float> previousSpectrum;
+
+    //samples of the next frame, the second half of each frame is the first half of the next
+    HeapBlock<float> frameInput;
+    int frameFill = 0;
+
+    //onset strength per frame, over the whole spectrum and over the low end
+    std::vector<float> onsets;
+    std::vector<float> lowOnsets;
+
+    double bpm = 0.0;
+    double firstBeatSeconds = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BeatDetector)
+};
@@ -6,48 +6,267 @@
 */
 
 #include "DJAudioPlayer.h"
+#include <cmath>
 
-DJAudioPlayer::DJAudioPlayer(AudioFormatManager& _formatManager)
-    :formatManager(_formatManager)
-{}
+namespace
+{
+    //loop lengths allowed, in beats
+    const double minLoopBeats = 0.25;
+    const double maxLoopBeats = 32.0;
+    //tempo of the beats a track without a beat grid is looped in
+    const double defaultLoopBpm = 120.0;
+
+    //a playing deck in sync closes a difference in phase with the master over about this long
+    const double syncCorrectionSeconds = 1.0;
+    //largest change of speed used to pull a deck into phase, small enough not to be heard as a pitch bend
+    const double maxSyncNudge = 0.04;
+}
+
+DJAudioPlayer::DJAudioPlayer(AudioFormatManager& _formatManager,
+    TimeSliceThread& _diskThread,
+    DecodedTrackCache& _decodedTracks,
+    PcmFileCache& _pcmCache)
+    :formatManager(_formatManager),
+    diskThread(_diskThread),
+    decodedTracks(_decodedTracks),
+    pcmCache(_pcmCache)
+{
+    loader.onTrackLoaded = [this](DeckTrack* track, const URL& audioURL, bool asNextTrack)
+    {
+        trackLoaded(track, audioURL, asNextTrack);
+    };
+}
 
 DJAudioPlayer::~DJAudioPlayer()
-{}
+{
+    //audio has stopped by now, so nothing else is using the tracks
+    delete currentTrack;
+    delete pendingTrack.exchange(nullptr);
+    delete pendingNextTrack.exchange(nullptr);
+    delete outgoingTrack;
+    for (DeckTrack* track : tracksAwaitingRetirement)
+    {
+        delete track;
+    }
+}
 
 //==============================================================================
-void DJAudioPlayer::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+void DJAudioPlayer::prepareToPlay(int samplesPerBlockExpected, double _sampleRate)
 {
-    transportSource.prepareToPlay(
-        samplesPerBlockExpected,
-        sampleRate);
+    blockSize = samplesPerBlockExpected;
+    sampleRate = _sampleRate;
+
+    //the device is stopped while it is being prepared, so the current track can be used here
+    if (currentTrack != nullptr)
+    {
+        currentTrack->prepareToPlay(samplesPerBlockExpected, _sampleRate);
+    }
+    {
+        //so is a track published but not taken yet. One published after this sees the new sample rate
+        const ScopedLock sl(publishLock);
+        if (DeckTrack* track = pendingTrack.load())
+        {
+            track->prepareToPlay(samplesPerBlockExpected, _sampleRate);
+        }
+        if (DeckTrack* track = pendingNextTrack.load())
+        {
+            track->prepareToPlay(samplesPerBlockExpected, _sampleRate);
+        }
+    }
     resampleSource.prepareToPlay(
         samplesPerBlockExpected,
-        sampleRate);
+        _sampleRate);
+    //allocates every buffer the time-stretcher needs, so switching key lock on never allocates
+    timeStretchSource.prepareToPlay(
+        samplesPerBlockExpected,
+        _sampleRate);
+    //likewise the loop and hot cue recordings
+    looper.prepareToPlay(samplesPerBlockExpected, _sampleRate);
+    //and the buffer the track being crossfaded out is read into, in pieces if the resampler asks for more
+    outgoingBuffer.setSize(2, jmax(4096, samplesPerBlockExpected * 4));
+    if (outgoingTrack != nullptr)
+    {
+        outgoingTrack->prepareToPlay(samplesPerBlockExpected, _sampleRate);
+    }
 }
 
 void DJAudioPlayer::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
 {
-    resampleSource.getNextAudioBlock(bufferToFill);
+    //hand over finished tracks the loader could not take on a previous block
+    for (DeckTrack*& track : tracksAwaitingRetirement)
+    {
+        if (track != nullptr && loader.retireTrack(track))
+        {
+            track = nullptr;
+        }
+    }
+
+    applyPendingCommands();
+    applySync();
+
+    if (keyLock)
+    {
+        timeStretchSource.getNextAudioBlock(bufferToFill);
+    }
+    else
+    {
+        resampleSource.getNextAudioBlock(bufferToFill);
+    }
+
+    //publish the playhead, loop and hot cues for the GUI
+    if (currentTrack != nullptr && currentTrack->getLengthInSeconds() > 0)
+    {
+        AudioTransportSource& transportSource = currentTrack->getTransport();
+        relativePosition = looper.getPosition() / sampleRate.load() / currentTrack->getLengthInSeconds();
+
+        positionSequence.fetch_add(1, std::memory_order_acq_rel);
+        blockEndSeconds.store(getHeardSeconds(), std::memory_order_relaxed);
+        blockLengthSeconds.store(currentTrack->getLengthInSeconds(), std::memory_order_relaxed);
+        blockPlaybackRate.store(transportSource.isPlaying() ? playbackSpeed : 0.0, std::memory_order_relaxed);
+        blockTimeMs.store(Time::getMillisecondCounterHiRes(), std::memory_order_relaxed);
+        positionSequence.fetch_add(1, std::memory_order_release);
+    }
+
+    int flags = 0;
+    for (int i = 0; i < DeckLooper::numHotCues; ++i)
+    {
+        flags |= looper.hasHotCue(i) ? 1 << i : 0;
+    }
+    hotCueFlags.store(flags, std::memory_order_relaxed);
+    publishedLoopBeats.store(looper.isLooping() ? loopBeats : 0.0, std::memory_order_relaxed);
+
+    //meter level, kept until the GUI reads it
+    const float blockPeak = bufferToFill.buffer->getMagnitude(bufferToFill.startSample, bufferToFill.numSamples);
+    if (blockPeak > peakLevel.load(std::memory_order_relaxed))
+    {
+        peakLevel.store(blockPeak, std::memory_order_relaxed);
+    }
 }
 
 void DJAudioPlayer::releaseResources()
 {
-    transportSource.releaseResources();
+    if (currentTrack != nullptr)
+    {
+        currentTrack->releaseResources();
+    }
     resampleSource.releaseResources();
+    timeStretchSource.releaseResources();
+    looper.releaseResources();
+}
+
+void DJAudioPlayer::addListener(Listener* listener)
+{
+    listeners.add(listener);
+}
+
+void DJAudioPlayer::removeListener(Listener* listener)
+{
+    listeners.remove(listener);
 }
 
 
 //==============================================================================
-void DJAudioPlayer::loadURL(URL audioURL)
+void DJAudioPlayer::loadURL(URL audioURL, double bpm, double firstBeatSeconds)
+{
+    gridURL = audioURL;
+    gridBpm = bpm;
+    gridFirstBeatSeconds = firstBeatSeconds;
+    loader.load(audioURL, blockSize.load(), sampleRate.load(), readAheadSamples.load(), ramResident.load());
+}
+
+void DJAudioPlayer::loadNextURL(URL audioURL, double bpm, double firstBeatSeconds)
+{
+    nextGridURL = audioURL;
+    nextGridBpm = bpm;
+    nextGridFirstBeatSeconds = firstBeatSeconds;
+    loader.load(audioURL, blockSize.load(), sampleRate.load(), readAheadSamples.load(), ramResident.load(), true);
+}
+
+void DJAudioPlayer::clearNextURL()
 {
-    auto* reader = formatManager.createReaderFor(audioURL.createInputStream(false));
-    if (reader != nullptr) // good file!
+    //a load still running is thrown away when it arrives
+    nextGridURL = URL();
+    const ScopedLock sl(publishLock);
+    delete pendingNextTrack.exchange(nullptr);
+}
+
+void DJAudioPlayer::setAutoAdvance(bool shouldAutoAdvance)
+{
+    pushCommand(DeckCommandQueue::Command::setAutoAdvance, shouldAutoAdvance ? 1.0 : 0.0);
+}
+
+void DJAudioPlayer::setAutoAdvanceBeats(double beats)
+{
+    autoAdvanceBeatsRequested = jmax(0.0, beats);
+    pushCommand(DeckCommandQueue::Command::setAutoAdvanceBeats, jmax(0.0, beats));
+}
+
+int DJAudioPlayer::getNumAutoAdvances() const
+{
+    return numAutoAdvances.load();
+}
+
+void DJAudioPlayer::trackLoaded(DeckTrack* track, const URL& audioURL, bool asNextTrack)
+{
+    if (asNextTrack)
     {
-        std::unique_ptr<AudioFormatReaderSource> newSource(new AudioFormatReaderSource(reader,
-            true));
-        transportSource.setSource(newSource.get(), 0, nullptr, reader->sampleRate);
-        readerSource.reset(newSource.release());
+        //replaced or cleared while it was loading
+        if (track == nullptr || !(audioURL == nextGridURL))
+        {
+            delete track;
+            return;
+        }
+
+        const ScopedLock sl(publishLock);
+        if (sampleRate.load() > 0 && !track->isPreparedFor(sampleRate.load()))
+        {
+            //opened again for the new device settings, the same as the track to play
+            loader.load(audioURL, blockSize.load(), sampleRate.load(), readAheadSamples.load(), ramResident.load(), true);
+            delete track;
+            return;
+        }
+        track->setBeatGrid(nextGridBpm, nextGridFirstBeatSeconds);
+
+        //a crossfade brings the next track in on its first downbeat. Positioned now,
+        //so the read-ahead buffer is filled from there long before the deck moves on
+        if (autoAdvanceBeatsRequested.load() > 0 && nextGridBpm > 0)
+        {
+            track->getTransport().setPosition(nextGridFirstBeatSeconds);
+        }
+
+        //the audio thread only takes the track when it moves on, one published earlier is replaced
+        delete pendingNextTrack.exchange(track);
+        return;
     }
+
+    if (track != nullptr) // good file!
+    {
+        //the audio thread only sees the track after it is published, so the grid can be set here
+        if (audioURL == gridURL)
+        {
+            track->setBeatGrid(gridBpm, gridFirstBeatSeconds);
+        }
+
+        const ScopedLock sl(publishLock);
+
+        //the device was restarted while the track was loading. It is opened again for the new settings
+        //rather than prepared here, as that would block the message thread while the read-ahead buffer fills
+        if (sampleRate.load() > 0 && !track->isPreparedFor(sampleRate.load()))
+        {
+            if (audioURL == gridURL)
+            {
+                loader.load(audioURL, blockSize.load(), sampleRate.load(), readAheadSamples.load(), ramResident.load());
+            }
+            delete track;
+            return;
+        }
+
+        //publish the track. A track published earlier and never taken by the audio thread is replaced
+        delete pendingTrack.exchange(track);
+        pushCommand(DeckCommandQueue::Command::swapTrack);
+    }
+
+    listeners.call([this, &audioURL, track](Listener& l) { l.playerTrackLoaded(this, audioURL, track != nullptr); });
 }
 
 void DJAudioPlayer::setGain(double gain)
@@ -55,7 +274,7 @@ void DJAudioPlayer::setGain(double gain)
     if (gain < 0 || gain >1) {}
     else
     {
-        transportSource.setGain(gain);
+        gainRequested = gain;
     }
 }
 
@@ -64,34 +283,585 @@ void DJAudioPlayer::setSpeed(double ratio)
     if (ratio < 0) {}
     else
     {
-        resampleSource.setResamplingRatio(ratio);
+        speedRequested = ratio;
+    }
+}
+
+void DJAudioPlayer::setKeyLock(bool shouldLockKey)
+{
+    keyLockRequested = shouldLockKey;
+    pushCommand(DeckCommandQueue::Command::setKeyLock, shouldLockKey ? 1.0 : 0.0);
+}
+
+bool DJAudioPlayer::isKeyLocked() const
+{
+    return keyLockRequested.load();
+}
+
+void DJAudioPlayer::setSync(bool shouldSync)
+{
+    syncRequested = shouldSync;
+    pushCommand(DeckCommandQueue::Command::setSync, shouldSync ? 1.0 : 0.0);
+}
+
+bool DJAudioPlayer::isSynced() const
+{
+    return syncRequested.load();
+}
+
+void DJAudioPlayer::setHotCue(int index)
+{
+    if (index >= 0 && index < DeckLooper::numHotCues)
+    {
+        pushCommand(DeckCommandQueue::Command::setHotCue, index);
     }
 }
 
+void DJAudioPlayer::clearHotCue(int index)
+{
+    if (index >= 0 && index < DeckLooper::numHotCues)
+    {
+        pushCommand(DeckCommandQueue::Command::clearHotCue, index);
+    }
+}
+
+void DJAudioPlayer::jumpToHotCue(int index)
+{
+    if (index >= 0 && index < DeckLooper::numHotCues)
+    {
+        pushCommand(DeckCommandQueue::Command::jumpToHotCue, index);
+    }
+}
+
+bool DJAudioPlayer::hasHotCue(int index) const
+{
+    return (hotCueFlags.load(std::memory_order_relaxed) & (1 << index)) != 0;
+}
+
+void DJAudioPlayer::setLoop(double beats)
+{
+    pushCommand(DeckCommandQueue::Command::setLoop, jlimit(minLoopBeats, maxLoopBeats, beats));
+}
+
+void DJAudioPlayer::exitLoop()
+{
+    pushCommand(DeckCommandQueue::Command::exitLoop);
+}
+
+double DJAudioPlayer::getLoopBeats() const
+{
+    return publishedLoopBeats.load(std::memory_order_relaxed);
+}
+
+void DJAudioPlayer::setTimeStretchQuality(TimeStretchAudioSource::Quality quality)
+{
+    pushCommand(DeckCommandQueue::Command::setTimeStretchQuality, (double)quality);
+}
+
+void DJAudioPlayer::setResamplerQuality(PolyphaseResamplingAudioSource::Quality quality)
+{
+    pushCommand(DeckCommandQueue::Command::setResamplerQuality, (double)quality);
+}
+
 void DJAudioPlayer::setRelativePosition(double pos)
 {
     if (pos < 0 || pos >1) {}
     else {
-        double posInSecs = transportSource.getLengthInSeconds() * pos;
-        setPosition(posInSecs);
+        //converted to samples on the audio thread, which knows the length of the loaded track
+        relativePositionRequested = pos;
     }
 }
 void DJAudioPlayer::setPosition(double posInSecs)
 {
-    transportSource.setPosition(posInSecs);
+    pushCommand(DeckCommandQueue::Command::setPosition, posInSecs);
 }
 
 void DJAudioPlayer::start()
 {
-    transportSource.start();
+    pushCommand(DeckCommandQueue::Command::start);
 }
 
 void DJAudioPlayer::stop()
 {
-    transportSource.stop();
+    pushCommand(DeckCommandQueue::Command::stop);
+}
+
+void DJAudioPlayer::setReadAheadSamples(int numSamples)
+{
+    //must hold at least a couple of device blocks to be of any use
+    readAheadSamples = jmax(4096, numSamples);
+}
+
+int DJAudioPlayer::getNumUnderruns() const
+{
+    return numUnderruns.load();
+}
+
+void DJAudioPlayer::setRamResident(bool shouldBeRamResident)
+{
+    ramResident = shouldBeRamResident;
+}
+
+bool DJAudioPlayer::isRamResident() const
+{
+    return ramResident.load();
 }
 
 double DJAudioPlayer::getRelativePosition()
 {
-    return transportSource.getCurrentPosition() / transportSource.getLengthInSeconds();
+    return relativePosition.load();
+}
+
+double DJAudioPlayer::getDisplayPosition() const
+{
+    double endSeconds, lengthSeconds, rate, timeMs;
+    uint32 sequence;
+    do
+    {
+        sequence = positionSequence.load(std::memory_order_acquire);
+        endSeconds = blockEndSeconds.load(std::memory_order_relaxed);
+        lengthSeconds = blockLengthSeconds.load(std::memory_order_relaxed);
+        rate = blockPlaybackRate.load(std::memory_order_relaxed);
+        timeMs = blockTimeMs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    while ((sequence & 1) != 0 || sequence != positionSequence.load(std::memory_order_relaxed));
+
+    if (lengthSeconds <= 0)
+    {
+        return 0.0;
+    }
+
+    //the end of the last block is heard one output latency after it was rendered
+    //capped, so the playhead does not run on if the device stops calling back
+    const double secondsSinceBlock = jmin(1.0, (Time::getMillisecondCounterHiRes() - timeMs) / 1000.0);
+    const double heardSeconds = endSeconds + (secondsSinceBlock - outputLatency.load()) * rate;
+    return jlimit(0.0, 1.0, heardSeconds / lengthSeconds);
+}
+
+void DJAudioPlayer::setOutputLatency(double seconds)
+{
+    outputLatency = seconds;
+}
+
+float DJAudioPlayer::getPeakLevelAndReset()
+{
+    return peakLevel.exchange(0.0f);
+}
+
+
+//==============================================================================
+void DJAudioPlayer::pushCommand(DeckCommandQueue::Command::Type type, double value)
+{
+    //a dropped swap, start or stop would leave the deck out of step with the GUI
+    const bool queued = commands.push(type, value);
+    jassert(queued);
+    ignoreUnused(queued);
+}
+
+void DJAudioPlayer::applyPendingCommands()
+{
+    //only the latest gain and speed matter, so they are read once per block rather than queued.
+    //The speed is passed on to the resampler and time-stretcher by applySync
+    const float requestedGain = (float)gainRequested.load();
+    if (requestedGain != gain)
+    {
+        gain = requestedGain;
+        if (currentTrack != nullptr)
+        {
+            currentTrack->getTransport().setGain(gain);
+        }
+    }
+    speed = speedRequested.load();
+
+    DeckCommandQueue::Command command;
+    while (commands.pop(command))
+    {
+        if (command.type == DeckCommandQueue::Command::swapTrack)
+        {
+            swapInPendingTrack();
+            continue;
+        }
+        if (command.type == DeckCommandQueue::Command::setSync && sync != (command.value > 0.5))
+        {
+            sync = command.value > 0.5;
+            snapToMasterPhase = sync && (currentTrack == nullptr || !currentTrack->getTransport().isPlaying());
+        }
+        if (command.type == DeckCommandQueue::Command::setKeyLock && keyLock != (command.value > 0.5))
+        {
+            //start the newly used path from the current position rather than with stale buffered audio
+            keyLock = command.value > 0.5;
+            timeStretchSource.reset();
+            resampleSource.reset();
+        }
+        if (command.type == DeckCommandQueue::Command::setTimeStretchQuality)
+        {
+            timeStretchSource.setQuality((TimeStretchAudioSource::Quality)(int)command.value);
+        }
+        if (command.type == DeckCommandQueue::Command::setResamplerQuality)
+        {
+            resampleSource.setQuality((PolyphaseResamplingAudioSource::Quality)(int)command.value);
+        }
+        if (command.type == DeckCommandQueue::Command::setAutoAdvance)
+        {
+            autoAdvance = command.value > 0.5;
+        }
+        if (command.type == DeckCommandQueue::Command::setAutoAdvanceBeats)
+        {
+            autoAdvanceBeats = command.value;
+        }
+
+        //the remaining commands control the loaded track
+        if (currentTrack == nullptr)
+        {
+            continue;
+        }
+        AudioTransportSource& transportSource = currentTrack->getTransport();
+
+        switch (command.type)
+        {
+        case DeckCommandQueue::Command::setPosition:
+            looper.setPosition((int64)(command.value * sampleRate.load()), transportSource);
+            timeStretchSource.reset();
+            resampleSource.reset();
+            break;
+        //hot cues and loops are played through the looper, so they never reset the resampler or time-stretcher
+        case DeckCommandQueue::Command::setHotCue:
+            looper.setHotCue((int)command.value);
+            break;
+        case DeckCommandQueue::Command::clearHotCue:
+            looper.clearHotCue((int)command.value);
+            break;
+        case DeckCommandQueue::Command::jumpToHotCue:
+            looper.jumpToHotCue((int)command.value, transportSource);
+            break;
+        case DeckCommandQueue::Command::setLoop:
+            startLoop(command.value);
+            break;
+        case DeckCommandQueue::Command::exitLoop:
+            looper.exitLoop();
+            break;
+        case DeckCommandQueue::Command::start:
+            snapToMasterPhase = sync && !transportSource.isPlaying();
+            transportSource.start();
+            break;
+        case DeckCommandQueue::Command::stop:
+            transportSource.stop();
+            //the track being faded out stops with it
+            if (outgoingTrack != nullptr)
+            {
+                retireTrack(outgoingTrack);
+                outgoingTrack = nullptr;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    //a track published without its swap command, which only happens if the queue was full, is still taken
+    if (pendingTrack.load() != nullptr)
+    {
+        swapInPendingTrack();
+    }
+
+    //the last position the slider was moved to, applied to whichever track is loaded once the commands are done
+    const double requestedPosition = relativePositionRequested.exchange(-1.0);
+    if (requestedPosition >= 0 && currentTrack != nullptr)
+    {
+        AudioTransportSource& transportSource = currentTrack->getTransport();
+        looper.setPosition((int64)(transportSource.getLengthInSeconds() * requestedPosition * sampleRate.load()), transportSource);
+        timeStretchSource.reset();
+        resampleSource.reset();
+    }
+}
+
+void DJAudioPlayer::swapInPendingTrack()
+{
+    DeckTrack* track = pendingTrack.exchange(nullptr);
+    if (track == nullptr)
+    {
+        return;
+    }
+
+    //prepared on the thread that published it or by prepareToPlay, never here
+    jassert(track->isPreparedFor(sampleRate.load()));
+    track->getTransport().setGain(gain);
+
+    //the old track is deleted by the loader thread, never here. A track loaded by hand cuts off any crossfade
+    if (currentTrack != nullptr)
+    {
+        retireTrack(currentTrack);
+    }
+    if (outgoingTrack != nullptr)
+    {
+        retireTrack(outgoingTrack);
+        outgoingTrack = nullptr;
+    }
+
+    currentTrack = track;
+    looper.reset(track->getTransport());
+    relativePosition = 0.0;
+    timeStretchSource.reset();
+    resampleSource.reset();
+}
+
+
+void DJAudioPlayer::retireTrack(DeckTrack* track)
+{
+    if (loader.retireTrack(track))
+    {
+        return;
+    }
+    for (DeckTrack*& waiting : tracksAwaitingRetirement)
+    {
+        if (waiting == nullptr)
+        {
+            waiting = track;
+            return;
+        }
+    }
+    //the loader thread has stopped taking tracks altogether
+    jassertfalse;
+}
+
+void DJAudioPlayer::renderTracks(const AudioSourceChannelInfo& bufferToFill)
+{
+    int startSample = bufferToFill.startSample;
+    int numSamples = bufferToFill.numSamples;
+
+    //play the current track up to the sample the next one is due, so nothing is dropped or repeated between them
+    const int64 advancePosition = getAutoAdvancePosition();
+    if (advancePosition >= 0)
+    {
+        const int numBeforeAdvance = (int)jlimit((int64)0, (int64)numSamples, advancePosition - looper.getPosition());
+        if (numBeforeAdvance < numSamples)
+        {
+            looper.getNextAudioBlock(AudioSourceChannelInfo(bufferToFill.buffer, startSample, numBeforeAdvance), currentTrack->getTransport());
+            mixOutgoingTrack(*bufferToFill.buffer, startSample, numBeforeAdvance);
+            advanceToNextTrack();
+            startSample += numBeforeAdvance;
+            numSamples -= numBeforeAdvance;
+        }
+    }
+
+    looper.getNextAudioBlock(AudioSourceChannelInfo(bufferToFill.buffer, startSample, numSamples), currentTrack->getTransport());
+    mixOutgoingTrack(*bufferToFill.buffer, startSample, numSamples);
+}
+
+int64 DJAudioPlayer::getAutoAdvancePosition() const
+{
+    //a deck holding a loop stays on its track. The transport may stop itself a few samples early when it resamples
+    AudioTransportSource& transportSource = currentTrack->getTransport();
+    if (!autoAdvance || pendingNextTrack.load() == nullptr || looper.isLooping()
+        || !(transportSource.isPlaying() || transportSource.hasStreamFinished()))
+    {
+        return -1;
+    }
+
+    const int64 length = transportSource.getTotalLength();
+    if (autoAdvanceBeats <= 0)
+    {
+        return length;
+    }
+
+    //start the crossfade on a beat of the grid, so the next track's first downbeat falls on a beat of this one
+    const bool hasGrid = currentTrack->getBpm() > 0;
+    const double beatLength = 60.0 / (hasGrid ? currentTrack->getBpm() : defaultLoopBpm) * sampleRate.load();
+    double fadeStart = length - autoAdvanceBeats * beatLength;
+    if (hasGrid)
+    {
+        const double firstBeat = currentTrack->getFirstBeatSeconds() * sampleRate.load();
+        fadeStart = firstBeat + std::floor((fadeStart - firstBeat) / beatLength) * beatLength;
+    }
+    return jmax((int64)0, (int64)fadeStart);
+}
+
+void DJAudioPlayer::advanceToNextTrack()
+{
+    DeckTrack* track = pendingNextTrack.exchange(nullptr);
+    if (track == nullptr)
+    {
+        return;
+    }
+    //prepared before it was published, or again by prepareToPlay, the same as a track loaded by hand
+    jassert(track->isPreparedFor(sampleRate.load()));
+    track->getTransport().setGain(gain);
+
+    //a crossfade still running from the track before is cut short
+    if (outgoingTrack != nullptr)
+    {
+        retireTrack(outgoingTrack);
+        outgoingTrack = nullptr;
+    }
+
+    if (autoAdvanceBeats > 0)
+    {
+        //faded out over the given number of its own beats
+        const double bpm = currentTrack->getBpm() > 0 ? currentTrack->getBpm() : defaultLoopBpm;
+        outgoingTrack = currentTrack;
+        outgoingFadeLength = jmax((int64)1, (int64)(autoAdvanceBeats * 60.0 / bpm * sampleRate.load()));
+        outgoingFadePosition = 0;
+    }
+    else
+    {
+        retireTrack(currentTrack);
+    }
+
+    //the resampler and time-stretcher are left alone, so the new track carries straight on from the old one
+    currentTrack = track;
+    looper.reset(track->getTransport());
+    track->getTransport().start();
+    ++numAutoAdvances;
+}
+
+void DJAudioPlayer::mixOutgoingTrack(AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    while (outgoingTrack != nullptr && numSamples > 0)
+    {
+        const int n = (int)jmin((int64)jmin(numSamples, outgoingBuffer.getNumSamples()), outgoingFadeLength - outgoingFadePosition);
+        outgoingTrack->getTransport().getNextAudioBlock(AudioSourceChannelInfo(&outgoingBuffer, 0, n));
+
+        //equal power, as the two tracks are unrelated
+        const float fadeFrom = MathConstants<float>::halfPi * (float)outgoingFadePosition / (float)outgoingFadeLength;
+        const float fadeTo = MathConstants<float>::halfPi * (float)(outgoingFadePosition + n) / (float)outgoingFadeLength;
+        buffer.applyGainRamp(startSample, n, std::sin(fadeFrom), std::sin(fadeTo));
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            buffer.addFromWithRamp(channel, startSample, outgoingBuffer.getReadPointer(jmin(channel, outgoingBuffer.getNumChannels() - 1)), n,
+                std::cos(fadeFrom), std::cos(fadeTo));
+        }
+
+        outgoingFadePosition += n;
+        startSample += n;
+        numSamples -= n;
+        if (outgoingFadePosition >= outgoingFadeLength)
+        {
+            retireTrack(outgoingTrack);
+            outgoingTrack = nullptr;
+        }
+    }
+}
+
+void DJAudioPlayer::startLoop(double beats)
+{
+    //the grid's beats, or even beats from the playhead for a track without one
+    const bool hasGrid = currentTrack->getBpm() > 0;
+    const double beatLength = 60.0 / (hasGrid ? currentTrack->getBpm() : defaultLoopBpm) * sampleRate.load();
+
+    //halved until it fits in memory
+    while (beats > minLoopBeats && beats * beatLength > looper.getMaxLoopLength())
+    {
+        beats *= 0.5;
+    }
+    const int64 length = (int64)std::round(beats * beatLength);
+
+    if (looper.isLooping())
+    {
+        looper.setLoopLength(length, currentTrack->getTransport());
+    }
+    else
+    {
+        //the loop starts on the first beat far enough ahead to record the crossfade into it
+        int64 start = looper.getPosition() + looper.getCrossfadeLength();
+        if (hasGrid)
+        {
+            const double firstBeat = currentTrack->getFirstBeatSeconds() * sampleRate.load();
+            start = (int64)std::ceil(firstBeat + std::ceil((start - firstBeat) / beatLength) * beatLength);
+        }
+        looper.setLoop(start, length);
+    }
+    loopBeats = beats;
+}
+
+void DJAudioPlayer::applySync()
+{
+    double newSpeed = speed;
+
+    //the master has to be playing for there to be a tempo to follow
+    if (sync && syncMaster.valid && syncMaster.tempo > 0 && currentTrack != nullptr && currentTrack->getBpm() > 0)
+    {
+        const double bpm = currentTrack->getBpm();
+
+        //count this track's beats at double or half time when that is closer to the master, so 87 follows 174
+        double beatScale = 1.0;
+        if (syncMaster.tempo / bpm > MathConstants<double>::sqrt2)
+        {
+            beatScale = 2.0;
+        }
+        else if (syncMaster.tempo / bpm < 1.0 / MathConstants<double>::sqrt2)
+        {
+            beatScale = 0.5;
+        }
+        newSpeed = syncMaster.tempo / (bpm * beatScale);
+
+        //difference in phase from the master, in beats, to the nearest beat
+        double phaseError = syncMaster.beats - getBeatClock().beats * beatScale;
+        phaseError -= std::floor(phaseError + 0.5);
+
+        if (snapToMasterPhase)
+        {
+            //a deck starting in sync jumps straight onto the master's beat
+            const double shiftSeconds = phaseError * 60.0 / (bpm * beatScale);
+            looper.setPosition(jmax((int64)0, looper.getPosition() + (int64)(shiftSeconds * sampleRate.load())), currentTrack->getTransport());
+            timeStretchSource.reset();
+            resampleSource.reset();
+        }
+        else
+        {
+            //a playing deck is nudged into phase rather than jumping, every block, so drift never builds up
+            newSpeed *= 1.0 + jlimit(-maxSyncNudge, maxSyncNudge, phaseError * 60.0 / syncMaster.tempo / syncCorrectionSeconds);
+        }
+    }
+    snapToMasterPhase = false;
+
+    playbackSpeed = jlimit(0.5, 2.0, newSpeed);
+    resampleSource.setResamplingRatio(playbackSpeed);
+    timeStretchSource.setTempo(playbackSpeed);
+}
+
+double DJAudioPlayer::getHeardSeconds() const
+{
+    //the time-stretcher holds back about one frame of the track it has read, and the resampler half a filter.
+    //Both count the track samples they have read ahead, so the same conversion suits either
+    if (sampleRate.load() <= 0)
+    {
+        return 0.0;
+    }
+    const int latencySamples = keyLock ? timeStretchSource.getLatencySamples() : resampleSource.getLatencySamples();
+    return jmax(0.0, (looper.getPosition() - latencySamples) / sampleRate.load());
+}
+
+DJAudioPlayer::BeatClock DJAudioPlayer::getBeatClock() const
+{
+    BeatClock clock;
+    if (currentTrack == nullptr || currentTrack->getBpm() <= 0)
+    {
+        return clock;
+    }
+
+    const double bpm = currentTrack->getBpm();
+    clock.valid = true;
+    clock.beats = (getHeardSeconds() - currentTrack->getFirstBeatSeconds()) * bpm / 60.0;
+    clock.tempo = currentTrack->getTransport().isPlaying() ? bpm * playbackSpeed : 0.0;
+    return clock;
+}
+
+void DJAudioPlayer::setSyncMaster(const BeatClock& master)
+{
+    syncMaster = master;
+}
+
+
+//==============================================================================
+void DJAudioPlayer::CurrentTrackSource::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
+{
+    if (owner.currentTrack != nullptr)
+    {
+        owner.renderTracks(bufferToFill);
+    }
+    else
+    {
+        bufferToFill.clearActiveBufferRegion();
+    }
 }
@@ -7,17 +7,54 @@
 
 #pragma once
 
-#include "../JuceLibraryCode/JuceHeader.h"
+#include <JuceHeader.h>
+#include "DeckCommandQueue.h"
+#include "DeckLooper.h"
+#include "DeckTrack.h"
+#include "DeckTrackLoader.h"
+#include "PolyphaseResamplingAudioSource.h"
+#include "TimeStretchAudioSource.h"
+#include <atomic>
 
 //===============================================================================
 /*
-    This component controls the actual playing of the audio files
+    This component controls the actual playing of the audio files.
+    Controls called from the message thread are queued and applied by the audio thread
+    at the start of the next block, so the audio callback never waits on the GUI. The gain, speed
+    and position slider only pass on their latest value, so dragging them never crowds out the rest.
+    Tracks are opened in the background and swapped in by the audio thread once they are ready.
 */
 class DJAudioPlayer : public AudioSource
 {
 public:
 
-    DJAudioPlayer(AudioFormatManager& formatManager);
+    //==============================================================================
+    /**Receives notifications about tracks loaded to the player, on the message thread*/
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+        /**Called once a track requested with loadURL is ready to play, or has failed to open*/
+        virtual void playerTrackLoaded(DJAudioPlayer* player, const URL& audioURL, bool loadedOk) = 0;
+    };
+
+    /**Where a deck is in its track's beat grid at the start of an audio block, for other decks to sync to*/
+    struct BeatClock
+    {
+        //false if no track with a beat grid is loaded
+        bool valid = false;
+        //beats since the first downbeat, at the audio being heard
+        double beats = 0.0;
+        //beats per minute as played, 0 while stopped
+        double tempo = 0.0;
+    };
+
+    /**Tracks are read ahead of the playhead by the disk thread, or decoded into the cache in RAM-resident mode,
+    from the PCM file cache once they have been decoded there. All of these may be shared between decks*/
+    DJAudioPlayer(AudioFormatManager& formatManager,
+        TimeSliceThread& diskThread,
+        DecodedTrackCache& decodedTracks,
+        PcmFileCache& pcmCache);
     ~DJAudioPlayer();
 
     //==============================================================================
@@ -31,36 +68,247 @@ public:
     For Audio Source component to release anything it no longer needs*/
     void releaseResources() override;
 
+    void addListener(Listener* listener);
+    void removeListener(Listener* listener);
 
     //==============================================================================
-    /**Set source for the transport and reader based on URL path*/
-    void loadURL(URL audioURL);
+    /**Open the file at the URL path in the background. Listeners are told once it has been loaded,
+    and the track already playing carries on until then. The beat grid from the library's analysis
+    is used for sync, a bpm of 0 means the track has none*/
+    void loadURL(URL audioURL, double bpm = 0.0, double firstBeatSeconds = 0.0);
+    /**Open the track to move on to with auto-advance in the background, with its read-ahead buffer filled,
+    so it can start without a gap. Replaces the next track opened before*/
+    void loadNextURL(URL audioURL, double bpm = 0.0, double firstBeatSeconds = 0.0);
+    /**Forget the next track*/
+    void clearNextURL();
+    /**With auto-advance on, a playing deck moves on to the next track at the end of the current one without a gap.
+    Given a number of beats, it crossfades into the next track over that many beats of the current one instead,
+    starting the next track from its first downbeat*/
+    void setAutoAdvance(bool shouldAutoAdvance);
+    void setAutoAdvanceBeats(double beats);
+    /**Number of times the deck has moved on to its next track, for the GUI to notice*/
+    int getNumAutoAdvances() const;
     /**Set gain (volume) based on input value between 0-1, received from the slider*/
     void setGain(double gain);
     /**Set speed based on input value as a ratio of speed, where 1 is the default 1x speed */
     void setSpeed(double ratio);
+    /**With key lock on, speed changes the tempo through the time-stretcher and leaves the pitch alone.
+    With it off, speed resamples the track and the pitch follows the tempo*/
+    void setKeyLock(bool shouldLockKey);
+    bool isKeyLocked() const;
+    /**With sync on, the speed follows the sync master's tempo and the beats are kept in phase with the master's,
+    in place of the speed set by setSpeed. A deck started in sync jumps onto the master's beat*/
+    void setSync(bool shouldSync);
+    bool isSynced() const;
+    /**Place a hot cue at the playhead, clear it, or jump to it. Hot cues are forgotten when a new track is loaded*/
+    void setHotCue(int index);
+    void clearHotCue(int index);
+    void jumpToHotCue(int index);
+    /**True if the hot cue was set as of the last audio block*/
+    bool hasHotCue(int index) const;
+    /**Loop the given number of beats, from a quarter to 32, starting on the next beat of the grid.
+    Changes the length of a loop already playing*/
+    void setLoop(double beats);
+    /**Stop looping, carrying on through the track from wherever the loop has got to*/
+    void exitLoop();
+    /**Length in beats of the loop playing as of the last audio block, 0 if not looping*/
+    double getLoopBeats() const;
+    /**Frame size of the time-stretcher used by key lock. Higher quality adds latency and CPU*/
+    void setTimeStretchQuality(TimeStretchAudioSource::Quality quality);
+    /**Filter length of the resampler used when key lock is off. Higher quality rejects more aliasing at high speeds*/
+    void setResamplerQuality(PolyphaseResamplingAudioSource::Quality quality);
     /**Identifies position in seconds based on input value 0-1, received from playback slider*/
     void setRelativePosition(double pos);
     /**Set position of the transport source playhead to the input value in seconds*/
     void setPosition(double posInSecs);
 
-    /**Get relative position of the playhead and returns value, used for plotting playhead on waveform*/
+    /**Get relative position of the playhead as of the last audio block*/
     double getRelativePosition();
+    /**Relative position of the audio being heard right now, used for plotting playhead on waveform.
+    Extrapolated from the last audio block by the time since it was rendered, less the output latency.
+    Lock-free, so it can be called every frame*/
+    double getDisplayPosition() const;
+    /**Set the time between an audio block being rendered and being heard, in seconds*/
+    void setOutputLatency(double seconds);
+    /**Highest sample level output since the last call, for the level meter*/
+    float getPeakLevelAndReset();
+
+    /**Set the size of the buffer read ahead of the playhead by the disk thread, used from the next track loaded*/
+    void setReadAheadSamples(int numSamples);
+    /**Number of audio blocks the read-ahead buffer could not supply in time since the player was created*/
+    int getNumUnderruns() const;
+
+    /**When enabled, tracks loaded from now on are decoded entirely into memory, so playing and
+    seeking never touch the disk. Tracks that do not fit in the cache's budget are still streamed*/
+    void setRamResident(bool shouldBeRamResident);
+    bool isRamResident() const;
 
     /**Start the transport source */
     void start();
     /**Stop the transport source */
     void stop();
 
+    //==============================================================================
+    /**Position in the beat grid of the current track. Audio thread only, between blocks*/
+    BeatClock getBeatClock() const;
+    /**Set the clock of the deck to follow in sync for the next block, invalid for the master itself.
+    Audio thread only, before the block*/
+    void setSyncMaster(const BeatClock& master);
+
 
 private: 
+    //==============================================================================
+    /**Forwards the audio of the current track through the looper to the resampler, mixed with the track being
+    crossfaded out, or silence if nothing is loaded*/
+    class CurrentTrackSource : public AudioSource
+    {
+    public:
+        CurrentTrackSource(DJAudioPlayer& _owner) : owner(_owner) {}
+        void prepareToPlay(int, double) override {}
+        void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override;
+        void releaseResources() override {}
+    private:
+        DJAudioPlayer& owner;
+    };
+
+    //==============================================================================
+    /**Queue a command for the audio thread. The continuous controls never use the queue, so it only fills
+    if the audio thread stops taking commands for a long time*/
+    void pushCommand(DeckCommandQueue::Command::Type type, double value = 0.0);
+    /**Apply the commands queued by the message thread and the latest gain, speed and position requested,
+    called at the start of each audio block*/
+    void applyPendingCommands();
+    /**Replace the current track with the one published by the message thread, on the audio thread*/
+    void swapInPendingTrack();
+    /**Fill the block with the current track, moving on to the next track at the exact sample it is due*/
+    void renderTracks(const AudioSourceChannelInfo& bufferToFill);
+    /**Position in the current track at which to move on to the next, or -1 if the deck is not about to*/
+    int64 getAutoAdvancePosition() const;
+    /**Make the next track the current one, keeping the old one playing under the crossfade if there is one*/
+    void advanceToNextTrack();
+    /**Add the track being crossfaded out to the block, fading the current track in against it*/
+    void mixOutgoingTrack(AudioBuffer<float>& buffer, int startSample, int numSamples);
+    /**Hand a track the audio thread has finished with to the loader to delete, or keep it to retry on the next block*/
+    void retireTrack(DeckTrack* track);
+    /**Start a loop of the given number of beats, or change the length of the loop playing*/
+    void startLoop(double beats);
+    /**Set the speed of the block from the speed control, or from the sync master while in sync*/
+    void applySync();
+    /**Position in the current track of the audio being heard, less what the resampler or time-stretcher holds back*/
+    double getHeardSeconds() const;
+    /**Called on the message thread by the loader when a track is ready*/
+    void trackLoaded(DeckTrack* track, const URL& audioURL, bool asNextTrack);
+
     //==============================================================================
     AudioFormatManager& formatManager;
 
-    std::unique_ptr<AudioFormatReaderSource> readerSource;
+    TimeSliceThread& diskThread;
+    DecodedTrackCache& decodedTracks;
+    PcmFileCache& pcmCache;
+
+    //blocks played before the disk thread had read them, counted by the audio thread
+    std::atomic<int> numUnderruns{ 0 };
+    //read-ahead buffer size for tracks loaded from now on
+    std::atomic<int> readAheadSamples{ 32768 };
+    //whether tracks loaded from now on are decoded into memory
+    std::atomic<bool> ramResident{ false };
+
+    //opens tracks in the background, and deletes the tracks the audio thread has finished with
+    DeckTrackLoader loader{ formatManager, diskThread, decodedTracks, pcmCache, numUnderruns };
+
+    //beat grid of the track last requested by loadURL, given to it once it has loaded. Message thread only
+    URL gridURL;
+    double gridBpm = 0.0;
+    double gridFirstBeatSeconds = 0.0;
+    //the same for the track last requested by loadNextURL, an empty URL once it has been cleared
+    URL nextGridURL;
+    double nextGridBpm = 0.0;
+    double nextGridFirstBeatSeconds = 0.0;
+
+    //track used by the audio thread
+    DeckTrack* currentTrack = nullptr;
+    //loaded track published by the message thread, taken by the audio thread with an atomic swap
+    std::atomic<DeckTrack*> pendingTrack{ nullptr };
+    //held while a track is published and while the device is prepared, so a published track is always
+    //prepared for the device's settings. Never taken by the audio thread
+    CriticalSection publishLock;
+    //next track published by the message thread, taken by the audio thread when it moves on
+    std::atomic<DeckTrack*> pendingNextTrack{ nullptr };
+    //finished tracks the loader could not take yet, retried on the next block
+    enum { maxTracksAwaitingRetirement = 4 };
+    DeckTrack* tracksAwaitingRetirement[maxTracksAwaitingRetirement] = {};
+
+    //previous track, still playing while the current one is crossfaded in over it
+    DeckTrack* outgoingTrack = nullptr;
+    int64 outgoingFadeLength = 0;
+    int64 outgoingFadePosition = 0;
+    AudioBuffer<float> outgoingBuffer;
+
+    //auto-advance settings used by the audio thread, and the beats as last requested by the message thread
+    bool autoAdvance = false;
+    double autoAdvanceBeats = 0.0;
+    std::atomic<double> autoAdvanceBeatsRequested{ 0.0 };
+    std::atomic<int> numAutoAdvances{ 0 };
+
+    //plays loops and hot cues of the current track from memory
+    DeckLooper looper;
+    //length of the loop playing in beats, only used by the audio thread
+    double loopBeats = 0.0;
+    //loop length and the hot cues set, published by the audio thread for the GUI
+    std::atomic<double> publishedLoopBeats{ 0.0 };
+    std::atomic<int> hotCueFlags{ 0 };
+
+    CurrentTrackSource currentTrackSource{ *this };
+
+    PolyphaseResamplingAudioSource resampleSource{ &currentTrackSource, 2 };
+    TimeStretchAudioSource timeStretchSource{ &currentTrackSource, 2 };
+
+    //device settings, used by the loader to prepare tracks before they are swapped in
+    std::atomic<int> blockSize{ 0 };
+    std::atomic<double> sampleRate{ 0.0 };
+
+    //gain applied to each track swapped in, only used by the audio thread, and the gain last requested
+    float gain = 1.0f;
+    std::atomic<double> gainRequested{ 1.0 };
+    //relative position to move to as requested by the position slider, or -1 if there is none waiting
+    std::atomic<double> relativePositionRequested{ -1.0 };
+
+    //commands from the message thread, waiting for the next audio block
+    DeckCommandQueue commands;
+
+    //playhead position published by the audio thread for the GUI
+    std::atomic<double> relativePosition{ 0.0 };
+
+    //state of the last audio block, published together for getDisplayPosition.
+    //The sequence is odd while the audio thread is writing, and readers retry until they see an even, unchanged value
+    std::atomic<uint32> positionSequence{ 0 };
+    std::atomic<double> blockEndSeconds{ 0.0 };
+    std::atomic<double> blockLengthSeconds{ 0.0 };
+    std::atomic<double> blockPlaybackRate{ 0.0 };
+    std::atomic<double> blockTimeMs{ 0.0 };
+    std::atomic<double> outputLatency{ 0.0 };
+
+    //speed ratio as last requested by setSpeed, and the copy used by the audio thread for the block
+    std::atomic<double> speedRequested{ 1.0 };
+    double speed = 1.0;
+    //speed the track is played at, which follows the sync master while in sync
+    double playbackSpeed = 1.0;
+    //whether the audio thread plays through the time-stretcher
+    bool keyLock = false;
+    //key lock setting as last requested by the message thread
+    std::atomic<bool> keyLockRequested{ false };
+
+    //whether the audio thread follows the sync master, and the setting as last requested by the message thread
+    bool sync = false;
+    std::atomic<bool> syncRequested{ false };
+    //the deck was started or synced while stopped, and jumps onto the master's beat on the next block
+    bool snapToMasterPhase = false;
+    //clock of the deck to follow, set before each block
+    BeatClock syncMaster;
 
-    AudioTransportSource transportSource;
+    //highest output level since the meter last read it
+    std::atomic<float> peakLevel{ 0.0f };
 
-    ResamplingAudioSource resampleSource{ &transportSource, false, 2 };
+    ListenerList<Listener> listeners;
 
 };
\ No newline at end of file
@@ -0,0 +1,44 @@
+/*
+  ==============================================================================
+    DeckCommandQueue.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "DeckCommandQueue.h"
+
+DeckCommandQueue::DeckCommandQueue(int capacity)
+    : fifo(capacity),
+      commands((size_t)capacity)
+{}
+
+//==============================================================================
+bool DeckCommandQueue::push(Command::Type type, double value)
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(1, start1, size1, start2, size2);
+    if (size1 + size2 < 1)
+    {
+        return false;
+    }
+
+    Command& command = commands[(size_t)(size1 > 0 ? start1 : start2)];
+    command.type = type;
+    command.value = value;
+    fifo.finishedWrite(1);
+    return true;
+}
+
+bool DeckCommandQueue::pop(Command& command)
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(1, start1, size1, start2, size2);
+    if (size1 + size2 < 1)
+    {
+        return false;
+    }
+
+    command = commands[(size_t)(size1 > 0 ? start1 : start2)];
+    fifo.finishedRead(1);
+    return true;
+}
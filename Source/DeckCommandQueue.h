@@ -0,0 +1,71 @@
+/*
+  ==============================================================================
+    DeckCommandQueue.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+//===============================================================================
+/*
+    Lock-free queue of commands sent from the message thread to a deck's audio thread.
+    Only one thread may push and only one thread may pop. Commands are applied by the
+    deck at the start of the next audio block. Continuous controls such as gain, speed and
+    the position slider are passed through atomics instead, so dragging them never fills the queue.
+*/
+class DeckCommandQueue
+{
+public:
+
+    //==============================================================================
+    /**A single change to the state of the deck*/
+    struct Command
+    {
+        enum Type
+        {
+            setPosition,
+            start,
+            stop,
+            setKeyLock,
+            setTimeStretchQuality,
+            setResamplerQuality,
+            setSync,
+            //the value is the index of the hot cue
+            setHotCue,
+            clearHotCue,
+            jumpToHotCue,
+            //the value is the length of the loop in beats
+            setLoop,
+            exitLoop,
+            setAutoAdvance,
+            //the value is the length of the crossfade into the next track in beats, 0 for none
+            setAutoAdvanceBeats,
+            //a newly loaded track has been published to the deck
+            swapTrack
+        };
+
+        Type type;
+        double value;
+    };
+
+    //==============================================================================
+    DeckCommandQueue(int capacity = 256);
+
+    /**Add a command to the queue, called from the message thread.
+    Returns false if the queue is full and the command was dropped*/
+    bool push(Command::Type type, double value = 0.0);
+    /**Take the oldest command from the queue, called from the audio thread.
+    Returns false if the queue is empty*/
+    bool pop(Command& command);
+
+private:
+    //==============================================================================
+    AbstractFifo fifo;
+    std::vector<Command> commands;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeckCommandQueue)
+};
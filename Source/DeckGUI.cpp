@@ -7,21 +7,26 @@
   ==============================================================================
 */
 
-#include "../JuceLibraryCode/JuceHeader.h"
+#include <JuceHeader.h>
 #include "DeckGUI.h"    
 #include <cmath>
 #include "PlaylistComponent.h"
 
 
-DeckGUI::DeckGUI(DJAudioPlayer* _player,
+DeckGUI::DeckGUI(DeckManager& deckManagerToUse,
                 PlaylistComponent* _playlistComponent,
                 AudioFormatManager& formatManagerToUse,
                 AudioThumbnailCache& cacheToUse, 
-                int channelToUse
-                ) : player(_player), 
+                PcmFileCache& pcmCacheToUse,
+                DisplayScheduler& schedulerToUse,
+                int deckIndexToUse
+                ) : deckManager(deckManagerToUse),
+                    player(deckManagerToUse.getPlayer(deckIndexToUse)),
+                    mixer(deckManagerToUse.getMixer()),
                     playlistComponent(_playlistComponent),
-                    waveformDisplay(formatManagerToUse,cacheToUse), 
-                    channel(channelToUse)
+                    waveformDisplay(formatManagerToUse, cacheToUse, pcmCacheToUse), 
+                    scheduler(schedulerToUse),
+                    deckIndex(deckIndexToUse)
 {
 
     //add buttons for each GUI and add listeners to them 
@@ -31,6 +36,39 @@ DeckGUI::DeckGUI(DJAudioPlayer* _player,
     playButton.addListener(this);
     stopButton.addListener(this);
     nextButton.addListener(this);
+    addAndMakeVisible(ramToggle);
+    ramToggle.addListener(this);
+    addAndMakeVisible(keyLockToggle);
+    keyLockToggle.addListener(this);
+
+    //longer time-stretch frames sound smoother, but the deck reacts later and costs more CPU
+    addAndMakeVisible(keyLockQualityBox);
+    keyLockQualityBox.addItem("Draft", 1 + TimeStretchAudioSource::draft);
+    keyLockQualityBox.addItem("Normal", 1 + TimeStretchAudioSource::normal);
+    keyLockQualityBox.addItem("High", 1 + TimeStretchAudioSource::high);
+    keyLockQualityBox.setSelectedId(1 + TimeStretchAudioSource::normal, juce::dontSendNotification);
+    keyLockQualityBox.addListener(this);
+
+    //auto mix cuts straight to the next track, or crossfades over a number of beats
+    addAndMakeVisible(autoMixToggle);
+    autoMixToggle.addListener(this);
+    addAndMakeVisible(autoMixBeatsBox);
+    autoMixBeatsBox.addItem("Gapless", 1);
+    autoMixBeatsBox.addItem("4 beats", 2);
+    autoMixBeatsBox.addItem("8 beats", 3);
+    autoMixBeatsBox.addItem("16 beats", 4);
+    autoMixBeatsBox.addItem("32 beats", 5);
+    autoMixBeatsBox.setSelectedId(1, juce::dontSendNotification);
+    autoMixBeatsBox.addListener(this);
+
+    //tempo sync, lit while on, and the master lit on whichever deck the others follow
+    addAndMakeVisible(syncButton);
+    syncButton.setClickingTogglesState(true);
+    syncButton.setColour(TextButton::buttonOnColourId, juce::Colours::mediumspringgreen.darker());
+    syncButton.addListener(this);
+    addAndMakeVisible(masterButton);
+    masterButton.setColour(TextButton::buttonOnColourId, juce::Colours::mediumspringgreen.darker());
+    masterButton.addListener(this);
 
     //add sliders for each GUI, format them, add labels, and add listeners to them 
     addAndMakeVisible(posSlider);
@@ -62,6 +100,63 @@ DeckGUI::DeckGUI(DJAudioPlayer* _player,
     speedLabel.attachToComponent(&speedSlider, false);
     speedLabel.setJustificationType(juce::Justification::centred);
 
+    //add knobs for the deck's channel strip, double click returns them to the centre
+    struct KnobSetup { Slider* knob; Label* label; const char* name; double minimum; double maximum; };
+    for (const KnobSetup& setup : { KnobSetup{ &trimKnob, &trimLabel, "TRIM", -12.0, 12.0 },
+                                    KnobSetup{ &highKnob, &highLabel, "HI", -26.0, 6.0 },
+                                    KnobSetup{ &midKnob, &midLabel, "MID", -26.0, 6.0 },
+                                    KnobSetup{ &lowKnob, &lowLabel, "LOW", -26.0, 6.0 } })
+    {
+        addAndMakeVisible(*setup.knob);
+        setup.knob->addListener(this);
+        setup.knob->setRange(setup.minimum, setup.maximum);
+        setup.knob->setValue(0.0);
+        setup.knob->setDoubleClickReturnValue(true, 0.0);
+        setup.knob->setSliderStyle(Slider::SliderStyle::RotaryHorizontalVerticalDrag);
+        setup.knob->setTextBoxStyle(Slider::NoTextBox, false, 0, 0);
+        addAndMakeVisible(*setup.label);
+        setup.label->setText(setup.name, juce::dontSendNotification);
+        setup.label->setJustificationType(juce::Justification::centred);
+    }
+
+    //decks alternate between the two ends of the crossfader
+    addAndMakeVisible(crossfaderSideBox);
+    crossfaderSideBox.addItem("A", 1 + DeckMixer::sideA);
+    crossfaderSideBox.addItem("Thru", 1 + DeckMixer::thru);
+    crossfaderSideBox.addItem("B", 1 + DeckMixer::sideB);
+    crossfaderSideBox.addListener(this);
+    crossfaderSideBox.setSelectedId(1 + (deckIndex % 2 == 0 ? DeckMixer::sideA : DeckMixer::sideB));
+    addAndMakeVisible(crossfaderSideLabel);
+    crossfaderSideLabel.setText("X-FADE", juce::dontSendNotification);
+    crossfaderSideLabel.setJustificationType(juce::Justification::centred);
+
+    //pre-listen the deck on the headphones
+    addAndMakeVisible(cueButton);
+    cueButton.setClickingTogglesState(true);
+    cueButton.setColour(TextButton::buttonOnColourId, juce::Colours::orange);
+    cueButton.addListener(this);
+
+    //hot cues lit while set, numbered from 1
+    for (int i = 0; i < DeckLooper::numHotCues; ++i)
+    {
+        addAndMakeVisible(hotCueButtons[i]);
+        hotCueButtons[i].setButtonText(String(i + 1));
+        hotCueButtons[i].setColour(TextButton::buttonOnColourId, juce::Colours::orange);
+        hotCueButtons[i].addListener(this);
+    }
+
+    //loop lengths from a quarter beat to 32 beats, lit while looping
+    addAndMakeVisible(loopLengthBox);
+    for (const char* length : { "1/4", "1/2", "1", "2", "4", "8", "16", "32" })
+    {
+        loopLengthBox.addItem(length, loopLengthBox.getNumItems() + 1);
+    }
+    loopLengthBox.setSelectedId(5, juce::dontSendNotification);
+    loopLengthBox.addListener(this);
+    addAndMakeVisible(loopButton);
+    loopButton.setColour(TextButton::buttonOnColourId, juce::Colours::mediumspringgreen.darker());
+    loopButton.addListener(this);
+
     //set colour scheme for sliders 
     getLookAndFeel().setColour(juce::Slider::thumbColourId, juce::Colours::mediumspringgreen); //dial
     getLookAndFeel().setColour(juce::Slider::trackColourId, juce::Colours::lightslategrey); //body
@@ -75,14 +170,21 @@ DeckGUI::DeckGUI(DJAudioPlayer* _player,
     upNext.setModel(this);
     addAndMakeVisible(upNext);
 
-    //start tread calling 10 times per second (once every 0.1 sec) 
-    startTimer(100);
+    //get told when tracks requested from the player have finished loading
+    player->addListener(this);
+
+    //add level meter beside the volume slider
+    addAndMakeVisible(levelMeter);
+
+    //update the playhead, meter and up next list once per frame, in step with the other decks
+    scheduler.addClient(this);
 }
     
 DeckGUI::~DeckGUI() 
 {
-    //stop timer when destroying class
-    stopTimer();
+    //stop frame updates when destroying class
+    scheduler.removeClient(this);
+    player->removeListener(this);
 }
 
 //==============================================================================
@@ -93,8 +195,10 @@ void DeckGUI::paint(Graphics & g)
 
 void DeckGUI::resized()
 {
-    double rowH = getHeight() / 6;
+    double rowH = getHeight() / 8;
     double colW = getWidth() / 4;
+    double knobW = getWidth() / 6;
+    double labelH = 16;
 
     /*  _________________________________________________
         |Waveform                                       |
@@ -102,8 +206,14 @@ void DeckGUI::resized()
         _________________________________________________
         |Pos Slider                                     |
         _________________________________________________
-        |Vol Slider |SpeedSlider       |Up Next List    |
-        |           |                  |                |
+        |Trim   |Hi     |Mid    |Low    |X-fade |Cue    |
+        _________________________________________________
+        |1      |2      |3      |4      |Beats  |Loop   |
+        _________________________________________________
+        |Vol Sl|Mtr |SpeedSlider       |Up Next List    |
+        |           |Sync   |Master    |                |
+        |           |Key Lock|Quality  |Auto Mix|Beats  |
+        |           |                  |Load to RAM     |
         |           _____________________________________
         |           |Play       |Stop       |Load/Next  |
         _________________________________________________
@@ -113,13 +223,41 @@ void DeckGUI::resized()
 
     posSlider.setBounds(0, rowH * 2, getWidth(), rowH);
 
-    volSlider.setBounds(0, rowH * 3 +20, colW, rowH*3 -30);    
-    speedSlider.setBounds(colW, rowH * 3 +20, colW*1.5, rowH*2 - 30);
-    upNext.setBounds(colW * 2.5, rowH * 3, colW * 1.5 - 20, rowH * 2);
-
-    playButton.setBounds(colW+10, rowH * 5 + 10, colW-20, rowH-20);
-    stopButton.setBounds(colW*2+10, rowH * 5 + 10, colW-20, rowH-20);
-    nextButton.setBounds(colW * 3 + 10, rowH * 5 + 10, colW - 20, rowH - 20);
+    //channel strip controls sit below their labels
+    trimLabel.setBounds(knobW * 0, rowH * 3, knobW, labelH);
+    highLabel.setBounds(knobW * 1, rowH * 3, knobW, labelH);
+    midLabel.setBounds(knobW * 2, rowH * 3, knobW, labelH);
+    lowLabel.setBounds(knobW * 3, rowH * 3, knobW, labelH);
+    crossfaderSideLabel.setBounds(knobW * 4, rowH * 3, knobW, labelH);
+    trimKnob.setBounds(knobW * 0, rowH * 3 + labelH, knobW, rowH - labelH);
+    highKnob.setBounds(knobW * 1, rowH * 3 + labelH, knobW, rowH - labelH);
+    midKnob.setBounds(knobW * 2, rowH * 3 + labelH, knobW, rowH - labelH);
+    lowKnob.setBounds(knobW * 3, rowH * 3 + labelH, knobW, rowH - labelH);
+    crossfaderSideBox.setBounds(knobW * 4 + 4, rowH * 3 + labelH + 2, knobW - 8, jmin(24.0, rowH - labelH - 4));
+    cueButton.setBounds(knobW * 5 + 4, rowH * 3 + 8, knobW - 8, rowH - 16);
+
+    for (int i = 0; i < DeckLooper::numHotCues; ++i)
+    {
+        hotCueButtons[i].setBounds(knobW * i + 4, rowH * 4 + 6, knobW - 8, rowH - 12);
+    }
+    loopLengthBox.setBounds(knobW * 4 + 4, rowH * 4 + 6, knobW - 8, rowH - 12);
+    loopButton.setBounds(knobW * 5 + 4, rowH * 4 + 6, knobW - 8, rowH - 12);
+
+    volSlider.setBounds(0, rowH * 5 +20, colW - 16, rowH*3 -30);    
+    levelMeter.setBounds(colW - 14, rowH * 5 + 20, 10, rowH * 3 - 30);
+    speedSlider.setBounds(colW, rowH * 5 +20, colW*1.5, rowH*2 - 66);
+    syncButton.setBounds(colW + 10, rowH * 7 - 44, colW * 0.75 - 12, 22);
+    masterButton.setBounds(colW * 1.75 + 2, rowH * 7 - 44, colW * 0.75 - 12, 22);
+    keyLockToggle.setBounds(colW + 10, rowH * 7 - 20, colW * 0.75 - 12, 20);
+    keyLockQualityBox.setBounds(colW * 1.75 + 2, rowH * 7 - 22, colW * 0.75 - 12, 22);
+    upNext.setBounds(colW * 2.5, rowH * 5, colW * 1.5 - 20, rowH * 2 - 46);
+    autoMixToggle.setBounds(colW * 2.5, rowH * 7 - 44, colW * 0.75 - 4, 22);
+    autoMixBeatsBox.setBounds(colW * 3.25, rowH * 7 - 44, colW * 0.75 - 20, 22);
+    ramToggle.setBounds(colW * 2.5, rowH * 7 - 20, colW * 1.5 - 20, 20);
+
+    playButton.setBounds(colW+10, rowH * 7 + 10, colW-20, rowH-20);
+    stopButton.setBounds(colW*2+10, rowH * 7 + 10, colW-20, rowH-20);
+    nextButton.setBounds(colW * 3 + 10, rowH * 7 + 10, colW - 20, rowH - 20);
 
 }
 
@@ -134,32 +272,80 @@ void DeckGUI::buttonClicked(Button* button)
     {
         player->stop();
     }
-    if (button == &nextButton)
-    {   
-        //handling next button for left channel
-        if (channel == 0 && playlistComponent->playListL.size() > 0) //handle only if there are songs added 
+    if (button == &ramToggle)
+    {
+        //applies to the next track loaded
+        player->setRamResident(ramToggle.getToggleState());
+    }
+    if (button == &keyLockToggle)
+    {
+        player->setKeyLock(keyLockToggle.getToggleState());
+    }
+    if (button == &autoMixToggle)
+    {
+        //the head of the up next list is opened on the next frame
+        player->setAutoAdvance(autoMixToggle.getToggleState());
+        if (!autoMixToggle.getToggleState())
         {
-            //get URL to first song of Left playlist
-            URL fileURL = URL{ File{playlistComponent->playListL[0]} }; 
-            //load the first URL 
-            player->loadURL(fileURL);
-            //display the waveforms
-            waveformDisplay.loadURL(fileURL);
-            //pop the first URL of the Left playlist so it doesn't replay
-            playlistComponent->playListL.erase(playlistComponent->playListL.begin()); 
+            player->clearNextURL();
+            nextTrackPath.clear();
         }
-
-        //handling next button for right channel
-        if (channel == 1 && playlistComponent->playListR.size() > 0)
+    }
+    if (button == &syncButton)
+    {
+        player->setSync(syncButton.getToggleState());
+    }
+    if (button == &masterButton)
+    {
+        deckManager.setSyncMaster(deckIndex);
+    }
+    if (button == &cueButton)
+    {
+        mixer.setCue(deckIndex, cueButton.getToggleState());
+    }
+    for (int i = 0; i < DeckLooper::numHotCues; ++i)
+    {
+        if (button == &hotCueButtons[i])
+        {
+            if (ModifierKeys::currentModifiers.isShiftDown())
+            {
+                player->clearHotCue(i);
+            }
+            else if (player->hasHotCue(i))
+            {
+                player->jumpToHotCue(i);
+            }
+            else
+            {
+                player->setHotCue(i);
+            }
+        }
+    }
+    if (button == &loopButton)
+    {
+        if (player->getLoopBeats() > 0)
+        {
+            player->exitLoop();
+        }
+        else
+        {
+            player->setLoop(getSelectedLoopBeats());
+        }
+    }
+    if (button == &nextButton)
+    {   
+        std::vector<std::string>& upNextList = playlistComponent->getUpNext(deckIndex);
+        if (upNextList.size() > 0) //handle only if there are songs added 
         {
-            //get URL to first song of playlist
-            URL fileURL = URL{ File{playlistComponent->playListR[0]} }; 
-            //load the first URL 
-            player->loadURL(fileURL);
-            //display the waveforms
-            waveformDisplay.loadURL(fileURL);
-            //pop the first URL of the Right playlist so it doesn't replay
-            playlistComponent->playListR.erase(playlistComponent->playListR.begin()); //remove first element
+            //get URL to first song of this deck's playlist
+            URL fileURL = URL{ File{upNextList[0]} }; 
+            //load the first URL in the background with its beat grid, the waveform is displayed once it is ready
+            double bpm = 0.0;
+            double firstBeatSeconds = 0.0;
+            playlistComponent->getBeatGrid(upNextList[0], bpm, firstBeatSeconds);
+            player->loadURL(fileURL, bpm, firstBeatSeconds);
+            //pop the first URL of the playlist so it doesn't replay
+            upNextList.erase(upNextList.begin()); 
         }
 
         //Buttons starts with indicating load. Once first songs have been loaded, we can change it to next 
@@ -169,7 +355,7 @@ void DeckGUI::buttonClicked(Button* button)
         }
         else
         {
-            player->start(); //starts player each time button labeled next is clicks
+            startWhenLoaded = true; //starts player each time button labeled next is clicked, once the track is ready
         }
     }
 
@@ -181,7 +367,24 @@ void DeckGUI::sliderValueChanged(Slider* slider)
 {
     if (slider == &volSlider)
     {
-        player->setGain(slider->getValue());
+        //the volume slider is the deck's fader in the mixer
+        mixer.setFader(deckIndex, (float)slider->getValue());
+    }
+    if (slider == &trimKnob)
+    {
+        mixer.setTrim(deckIndex, (float)slider->getValue());
+    }
+    if (slider == &highKnob)
+    {
+        mixer.setEqGain(deckIndex, DeckMixer::high, (float)slider->getValue());
+    }
+    if (slider == &midKnob)
+    {
+        mixer.setEqGain(deckIndex, DeckMixer::mid, (float)slider->getValue());
+    }
+    if (slider == &lowKnob)
+    {
+        mixer.setEqGain(deckIndex, DeckMixer::low, (float)slider->getValue());
     }
 
     if (slider == &speedSlider)
@@ -195,19 +398,42 @@ void DeckGUI::sliderValueChanged(Slider* slider)
 
 }
 
-
-//==============================================================================
-int DeckGUI::getNumRows()
+void DeckGUI::comboBoxChanged(ComboBox* comboBox)
 {
-    //number of rows in the table depends on the number of songs loaded to the respective channels
-    if (channel == 0) //left
+    if (comboBox == &crossfaderSideBox)
     {
-        return playlistComponent->playListL.size();
+        mixer.setCrossfaderSide(deckIndex, (DeckMixer::CrossfaderSide)(crossfaderSideBox.getSelectedId() - 1));
     }
-    if (channel == 1) //right
+    if (comboBox == &autoMixBeatsBox)
     {
-        return playlistComponent->playListR.size();
+        const double beats = autoMixBeatsBox.getSelectedId() == 1 ? 0.0 : 2.0 * std::pow(2.0, autoMixBeatsBox.getSelectedId() - 1);
+        player->setAutoAdvanceBeats(beats);
+        //opened again, as a crossfade starts the next track from its first downbeat rather than the top
+        nextTrackPath.clear();
     }
+    if (comboBox == &keyLockQualityBox)
+    {
+        player->setTimeStretchQuality((TimeStretchAudioSource::Quality)(keyLockQualityBox.getSelectedId() - 1));
+    }
+    if (comboBox == &loopLengthBox && player->getLoopBeats() > 0)
+    {
+        //resize the loop playing
+        player->setLoop(getSelectedLoopBeats());
+    }
+}
+
+double DeckGUI::getSelectedLoopBeats() const
+{
+    //items double from a quarter beat
+    return 0.25 * std::pow(2.0, loopLengthBox.getSelectedId() - 1);
+}
+
+
+//==============================================================================
+int DeckGUI::getNumRows()
+{
+    //number of rows in the table depends on the number of songs queued on this deck
+    return (int)playlistComponent->getUpNext(deckIndex).size();
 }
 
 void DeckGUI::paintRowBackground(Graphics& g,
@@ -227,17 +453,13 @@ void DeckGUI::paintCell(Graphics& g,
     int height,
     bool rowIsSelected)
 {
-    std::string filepath = "";
-
-    // get file path depending on channel
-    if (channel == 0) //left
-    {
-        filepath = playlistComponent->playListL[rowNumber];
-    }
-    if (channel == 1) //right
+    // get file path from this deck's list
+    std::vector<std::string>& upNextList = playlistComponent->getUpNext(deckIndex);
+    if (rowNumber >= (int)upNextList.size())
     {
-        filepath = playlistComponent->playListR[rowNumber];
+        return;
     }
+    std::string filepath = upNextList[rowNumber];
 
     // extract file name from path 
     std::size_t startFilePos = filepath.find_last_of("\\");
@@ -253,8 +475,79 @@ void DeckGUI::paintCell(Graphics& g,
 }
 
 
-void DeckGUI::timerCallback()
+void DeckGUI::playerTrackLoaded(DJAudioPlayer* loadedPlayer, const URL& audioURL, bool loadedOk)
+{
+    if (loadedOk)
+    {
+        //display the waveforms
+        waveformDisplay.loadURL(audioURL);
+
+        if (startWhenLoaded)
+        {
+            player->start();
+        }
+    }
+    startWhenLoaded = false;
+}
+
+void DeckGUI::displayRefresh()
 {
     waveformDisplay.setRelativePosition(
-        player->getRelativePosition());
+        player->getDisplayPosition());
+
+    levelMeter.setLevel(player->getPeakLevelAndReset());
+
+    masterButton.setToggleState(deckManager.getSyncMaster() == deckIndex, juce::dontSendNotification);
+
+    //loops end and hot cues are forgotten on the audio thread, when the playhead jumps or a track is loaded
+    for (int i = 0; i < DeckLooper::numHotCues; ++i)
+    {
+        hotCueButtons[i].setToggleState(player->hasHotCue(i), juce::dontSendNotification);
+    }
+    loopButton.setToggleState(player->getLoopBeats() > 0, juce::dontSendNotification);
+
+    //the player moved on to the track opened from the head of the up next list
+    if (player->getNumAutoAdvances() != autoAdvancesSeen)
+    {
+        autoAdvancesSeen = player->getNumAutoAdvances();
+        std::vector<std::string>& upNextList = playlistComponent->getUpNext(deckIndex);
+        if (upNextList.size() > 0 && upNextList[0] == nextTrackPath)
+        {
+            upNextList.erase(upNextList.begin());
+        }
+        waveformDisplay.loadURL(URL{ File{ nextTrackPath } });
+        nextTrackPath.clear();
+    }
+
+    //keep whatever is at the head of the list open, ready to move on to without a gap
+    if (autoMixToggle.getToggleState())
+    {
+        const std::vector<std::string>& upNextList = playlistComponent->getUpNext(deckIndex);
+        const std::string head = upNextList.size() > 0 ? upNextList[0] : std::string();
+        if (head != nextTrackPath)
+        {
+            nextTrackPath = head;
+            if (head.empty())
+            {
+                player->clearNextURL();
+            }
+            else
+            {
+                double bpm = 0.0;
+                double firstBeatSeconds = 0.0;
+                playlistComponent->getBeatGrid(head, bpm, firstBeatSeconds);
+                player->loadNextURL(URL{ File{ head } }, bpm, firstBeatSeconds);
+            }
+        }
+    }
+
+    //tracks can be queued from the library as well as removed by this deck's buttons. The contents are compared,
+    //as a track queued while another moves on leaves the number of rows the same
+    const std::vector<std::string>& upNextList = playlistComponent->getUpNext(deckIndex);
+    if (upNextList != upNextShown)
+    {
+        upNextShown = upNextList;
+        upNext.updateContent();
+        upNext.repaint();
+    }
 }
@@ -9,30 +9,39 @@
 
 #pragma once
 
-#include "../JuceLibraryCode/JuceHeader.h"
+#include <JuceHeader.h>
 #include "DJAudioPlayer.h"
+#include "DeckManager.h"
+#include "DeckMixer.h"
 #include "WaveformDisplay.h"
 #include "PlaylistComponent.h"
+#include "DisplayScheduler.h"
+#include "LevelMeter.h"
 
 //===============================================================================
 /*
-    This component controls the GUI interface of the application for each channel
+    This component controls the GUI interface of the application for each deck
 */
 
 class DeckGUI : public Component,
     public Button::Listener,
     public Slider::Listener,
+    public ComboBox::Listener,
     public TableListBoxModel,
-    public Timer
+    public DisplayScheduler::Client,
+    public DJAudioPlayer::Listener
 {
 public:
 
     //==============================================================================
-    DeckGUI(DJAudioPlayer* player,
+    /**Controls the player and channel strip of the deck at deckIndexToUse in the deck manager*/
+    DeckGUI(DeckManager& deckManagerToUse,
         PlaylistComponent* playlistComponent,
         AudioFormatManager& formatManagerToUse,
         AudioThumbnailCache& cacheToUse, 
-        int channelToUse);
+        PcmFileCache& pcmCacheToUse,
+        DisplayScheduler& schedulerToUse,
+        int deckIndexToUse);
     ~DeckGUI();
 
 
@@ -52,6 +61,11 @@ public:
     Called when the slider's value is changed, allowing interacion of vol,speed,playback sliders with the player*/
     void sliderValueChanged(Slider* slider) override;
 
+    /**Override of ComboBox::Listener pure virtual.
+    Called when the crossfader side is changed, to send it to the mixer, the loop length to resize the loop playing,
+    the auto mix crossfade length, or the key lock quality*/
+    void comboBoxChanged(ComboBox* comboBox) override;
+
 
     //==============================================================================
     /**Override of TableListBoxModel pure virtual.For up next table in GUI
@@ -75,42 +89,103 @@ public:
 
 
     //==============================================================================
-    /**Override of Timer pure virtual.To allow call back for updating waveform visual*/ 
-    void timerCallback() override;
+    /**Override of DisplayScheduler::Client pure virtual. Called every frame to move the playhead,
+    update the level meter, show which deck is the sync master, light the hot cues and loop set, keep the head of the up next list open for auto mix, and refresh the up next list when tracks have been queued*/
+    void displayRefresh() override;
+
+
+    //==============================================================================
+    /**Override of DJAudioPlayer::Listener pure virtual. 
+    Called once the track requested by the load/next button is ready, to show its waveform and start it*/
+    void playerTrackLoaded(DJAudioPlayer* player, const URL& audioURL, bool loadedOk) override;
 
     
 private: 
 
+    /**Length of loop chosen in the loop length box, in beats*/
+    double getSelectedLoopBeats() const;
+
     //Create Buttons
     TextButton playButton{ "PLAY" };
     TextButton stopButton{ "PAUSE" };
     TextButton nextButton{ "LOAD" };
 
+    //Load tracks entirely into memory
+    ToggleButton ramToggle{ "Load to RAM" };
+    //Move on through the up next list by itself, cutting or crossfading over the beats chosen in the box
+    ToggleButton autoMixToggle{ "Auto Mix" };
+    ComboBox autoMixBeatsBox;
+    //Change tempo without changing pitch, with the time-stretcher's quality chosen in the box
+    ToggleButton keyLockToggle{ "Key Lock" };
+    ComboBox keyLockQualityBox;
+    //Follow the tempo and beats of the master deck, and make this deck the master
+    TextButton syncButton{ "SYNC" };
+    TextButton masterButton{ "MASTER" };
+
     //Create Sliders 
     Slider volSlider;
     Slider speedSlider;
     Slider posSlider;
 
+    //Channel strip of the deck in the mixer
+    Slider trimKnob;
+    Slider highKnob;
+    Slider midKnob;
+    Slider lowKnob;
+    ComboBox crossfaderSideBox;
+    //Send the deck to the cue bus
+    TextButton cueButton{ "CUE" };
+
+    //Hot cues, set by the first click and jumped to by the next, shift-click clears
+    TextButton hotCueButtons[DeckLooper::numHotCues];
+    //Loop the number of beats chosen in the box
+    ComboBox loopLengthBox;
+    TextButton loopButton{ "LOOP" };
+
     //Add labels to sliders 
     Label volLabel; 
     Label speedLabel;
+    Label trimLabel;
+    Label highLabel;
+    Label midLabel;
+    Label lowLabel;
+    Label crossfaderSideLabel;
 
     //Control visual theme
     LookAndFeel_V4 lookandfeel;
 
+    //decks, used to choose the sync master
+    DeckManager& deckManager;
     //Create player associated with the GUI
     DJAudioPlayer* player;
+    //mixer holding the deck's channel strip
+    DeckMixer& mixer;
     //Create playlist component associated with the GUI
     PlaylistComponent* playlistComponent;
 
     //Create waveform visual
     WaveformDisplay waveformDisplay;
 
+    //output level of the deck
+    LevelMeter levelMeter;
+
+    //frame timer shared with the other decks
+    DisplayScheduler& scheduler;
+
     //Create table containing list of upcoming songs in the playlist
     TableListBox upNext;
+    //tracks shown in the up next table, to notice when tracks are queued from the library
+    std::vector<std::string> upNextShown;
+
+    //track opened as the player's next track for auto mix, and the player's count of moves to it last seen
+    std::string nextTrackPath;
+    int autoAdvancesSeen = 0;
+
+    //deck associated with the GUI, used to find its up next list in the playlist
+    int deckIndex;
 
-    //variable indicating channel associated with the GUI (0=Left, 1=Right)
-    int channel;
+    //whether the track being loaded should start playing as soon as it is ready
+    bool startWhenLoaded = false;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeckGUI);
 };
\ No newline at end of file
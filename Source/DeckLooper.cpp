@@ -0,0 +1,394 @@
+/*
+  ==============================================================================
+    DeckLooper.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "DeckLooper.h"
+#include <cmath>
+
+namespace
+{
+    //room for 32 beats down to 60 bpm
+    const double maxLoopSeconds = 32.0;
+    //long enough for the read-ahead buffer to refill after a jump to a hot cue
+    const double hotCueSeconds = 2.0;
+    //short enough not to smear a beat, long enough not to click
+    const double crossfadeSeconds = 0.005;
+}
+
+DeckLooper::DeckLooper()
+{}
+
+DeckLooper::~DeckLooper()
+{}
+
+//==============================================================================
+void DeckLooper::prepareToPlay(int, double _sampleRate)
+{
+    sampleRate = _sampleRate;
+    crossfadeLength = jmax(1, roundToInt(crossfadeSeconds * sampleRate));
+
+    loopRecording.setSize(2, crossfadeLength + (int)(maxLoopSeconds * sampleRate));
+    for (HotCue& cue : hotCues)
+    {
+        cue.recording.setSize(2, (int)(hotCueSeconds * sampleRate));
+        cue.set = false;
+    }
+    jumpFade.setSize(2, crossfadeLength);
+
+    //equal power, as the audio either side of a jump is unrelated
+    fadeInGains.resize((size_t)crossfadeLength);
+    for (int i = 0; i < crossfadeLength; ++i)
+    {
+        fadeInGains[(size_t)i] = std::sin(MathConstants<float>::halfPi * (i + 0.5f) / crossfadeLength);
+    }
+
+    //positions at the old sample rate mean nothing now
+    looping = false;
+    memory = nullptr;
+    jumpFadeRemaining = 0;
+    positionUnknown = true;
+}
+
+void DeckLooper::releaseResources()
+{
+    loopRecording.setSize(0, 0);
+    for (HotCue& cue : hotCues)
+    {
+        cue.recording.setSize(0, 0);
+        cue.set = false;
+    }
+    looping = false;
+    memory = nullptr;
+}
+
+void DeckLooper::reset(AudioTransportSource& transport)
+{
+    looping = false;
+    memory = nullptr;
+    for (HotCue& cue : hotCues)
+    {
+        cue.set = false;
+    }
+    jumpFadeRemaining = 0;
+    position = transportPosition = transport.getNextReadPosition();
+    positionUnknown = false;
+}
+
+void DeckLooper::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill, AudioTransportSource& transport)
+{
+    const bool playing = transport.isPlaying();
+
+    //only counted while playing, as the transport's own position runs slightly ahead when it resamples
+    if (memory == nullptr && (!playing || positionUnknown))
+    {
+        position = transportPosition = transport.getNextReadPosition();
+        positionUnknown = false;
+    }
+
+    if (!playing)
+    {
+        if (memory == nullptr)
+        {
+            //the transport fades itself out as it stops
+            transport.getNextAudioBlock(bufferToFill);
+        }
+        else
+        {
+            //fade out audio from memory the same way, without reading on from the stopped transport
+            bufferToFill.clearActiveBufferRegion();
+            const int numSamples = wasPlaying ? (int)jmin((int64)bufferToFill.numSamples, memoryEnd - position) : 0;
+            if (numSamples > 0)
+            {
+                render(*bufferToFill.buffer, bufferToFill.startSample, numSamples, transport);
+                bufferToFill.buffer->applyGainRamp(bufferToFill.startSample, numSamples, 1.0f, 0.0f);
+            }
+        }
+        jumpFadeRemaining = 0;
+        wasPlaying = false;
+        return;
+    }
+    wasPlaying = true;
+
+    render(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples, transport);
+
+    //fade out the audio the last jump cut off over the start of the new audio
+    const int numFaded = jmin(jumpFadeRemaining, bufferToFill.numSamples);
+    if (numFaded > 0)
+    {
+        const int fadeStart = crossfadeLength - jumpFadeRemaining;
+        for (int channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
+        {
+            float* samples = bufferToFill.buffer->getWritePointer(channel, bufferToFill.startSample);
+            const float* cutOff = jumpFade.getReadPointer(jmin(channel, jumpFade.getNumChannels() - 1), fadeStart);
+            for (int i = 0; i < numFaded; ++i)
+            {
+                const int j = fadeStart + i;
+                samples[i] = samples[i] * fadeInGains[(size_t)j] + cutOff[i] * fadeInGains[(size_t)(crossfadeLength - 1 - j)];
+            }
+        }
+        jumpFadeRemaining -= numFaded;
+    }
+}
+
+
+//==============================================================================
+int64 DeckLooper::getPosition() const
+{
+    return position;
+}
+
+void DeckLooper::setPosition(int64 newPosition, AudioTransportSource& transport)
+{
+    beginJump(transport);
+    looping = false;
+    memory = nullptr;
+    transport.setNextReadPosition(newPosition);
+    position = transportPosition = newPosition;
+}
+
+int64 DeckLooper::getMaxLoopLength() const
+{
+    return jmax(0, loopRecording.getNumSamples() - crossfadeLength);
+}
+
+void DeckLooper::setLoop(int64 start, int64 length)
+{
+    //recording starts a crossfade before the loop, and has to start ahead of the playhead
+    looping = true;
+    loopStart = jmax(start, position + crossfadeLength);
+    loopLength = jlimit((int64)crossfadeLength * 2, getMaxLoopLength(), length);
+    loopRecordedEnd = loopStart - crossfadeLength;
+}
+
+void DeckLooper::setLoopLength(int64 length, AudioTransportSource& transport)
+{
+    if (!looping)
+    {
+        return;
+    }
+    loopLength = jlimit((int64)crossfadeLength * 2, getMaxLoopLength(), length);
+
+    if (position >= loopStart + loopLength)
+    {
+        beginJump(transport);
+        if (loopRecordedEnd < position)
+        {
+            looping = false;
+            return;
+        }
+
+        //the audio the playhead has passed is all recorded, so it moves back into the loop in memory,
+        //by whole loops so a loop of whole beats stays on the beat
+        memory = &loopRecording;
+        memoryStart = loopStart;
+        memoryOffset = crossfadeLength;
+        memoryEnd = loopRecordedEnd;
+        position = loopStart + (position - loopStart) % loopLength;
+    }
+}
+
+void DeckLooper::exitLoop()
+{
+    //the rest of the recording, if any, is played before the transport carries on where it left off
+    looping = false;
+}
+
+bool DeckLooper::isLooping() const
+{
+    return looping;
+}
+
+int64 DeckLooper::getCrossfadeLength() const
+{
+    return crossfadeLength;
+}
+
+void DeckLooper::setHotCue(int index)
+{
+    HotCue& cue = hotCues[index];
+    cue.set = true;
+    cue.position = position;
+    cue.recordedEnd = position;
+}
+
+void DeckLooper::clearHotCue(int index)
+{
+    hotCues[index].set = false;
+}
+
+bool DeckLooper::hasHotCue(int index) const
+{
+    return hotCues[index].set;
+}
+
+void DeckLooper::jumpToHotCue(int index, AudioTransportSource& transport)
+{
+    HotCue& cue = hotCues[index];
+    if (!cue.set)
+    {
+        return;
+    }
+    if (cue.recordedEnd <= cue.position)
+    {
+        //not played through since it was placed, so nothing has been recorded
+        setPosition(cue.position, transport);
+        return;
+    }
+
+    beginJump(transport);
+    looping = false;
+    memory = &cue.recording;
+    memoryStart = cue.position;
+    memoryOffset = 0;
+    memoryEnd = cue.recordedEnd;
+    position = cue.position;
+
+    //the disk thread reads on from the end of the recording while it plays
+    transport.setNextReadPosition(cue.recordedEnd);
+    transportPosition = cue.recordedEnd;
+}
+
+
+//==============================================================================
+void DeckLooper::render(AudioBuffer<float>& buffer, int startSample, int numSamples, AudioTransportSource& transport)
+{
+    while (numSamples > 0)
+    {
+        //stop at the end of the loop or of the audio in memory, whichever comes first
+        const int64 loopEnd = loopStart + loopLength;
+        int64 end = position + numSamples;
+        if (looping && position < loopEnd)
+        {
+            end = jmin(end, loopEnd);
+        }
+        if (memory != nullptr)
+        {
+            end = jmin(end, memoryEnd);
+        }
+        const int n = (int)(end - position);
+
+        if (memory != nullptr)
+        {
+            const int offset = memoryOffset + (int)(position - memoryStart);
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+            {
+                buffer.copyFrom(channel, startSample, *memory, jmin(channel, memory->getNumChannels() - 1), offset, n);
+            }
+        }
+        else
+        {
+            transport.getNextAudioBlock(AudioSourceChannelInfo(&buffer, startSample, n));
+        }
+
+        //recordings hold the track as it is, so they are made before the loop's crossfade
+        if (looping)
+        {
+            record(buffer, startSample, n, position, loopRecording, loopStart - crossfadeLength, loopRecordedEnd, loopEnd);
+        }
+        for (HotCue& cue : hotCues)
+        {
+            if (cue.set)
+            {
+                record(buffer, startSample, n, position, cue.recording, cue.position, cue.recordedEnd,
+                    cue.position + cue.recording.getNumSamples());
+            }
+        }
+        if (looping)
+        {
+            fadeLoopEnd(buffer, startSample, n);
+        }
+
+        position += n;
+        startSample += n;
+        numSamples -= n;
+        if (memory == nullptr)
+        {
+            transportPosition = position;
+        }
+
+        if (looping && position == loopEnd)
+        {
+            if (loopRecordedEnd >= loopEnd)
+            {
+                //round again, from memory
+                memory = &loopRecording;
+                memoryStart = loopStart;
+                memoryOffset = crossfadeLength;
+                memoryEnd = loopRecordedEnd;
+                position = loopStart;
+                continue;
+            }
+            //the playhead jumped into the middle of the loop before it was recorded
+            looping = false;
+        }
+
+        if (memory != nullptr && position == memoryEnd)
+        {
+            memory = nullptr;
+            //the transport is somewhere else only when a loop was set in audio played from a hot cue
+            if (transportPosition != position)
+            {
+                transport.setNextReadPosition(position);
+                transportPosition = position;
+            }
+        }
+    }
+}
+
+void DeckLooper::record(const AudioBuffer<float>& buffer, int startSample, int numSamples, int64 blockPosition,
+    AudioBuffer<float>& recording, int64 origin, int64& recordedEnd, int64 limit)
+{
+    //only audio carrying straight on from what has been recorded, so a jump never leaves a gap in it
+    if (recordedEnd < blockPosition || recordedEnd >= blockPosition + numSamples || recordedEnd >= limit)
+    {
+        return;
+    }
+
+    const int n = (int)(jmin(blockPosition + numSamples, limit) - recordedEnd);
+    const int offset = (int)(recordedEnd - blockPosition);
+    for (int channel = 0; channel < recording.getNumChannels(); ++channel)
+    {
+        recording.copyFrom(channel, (int)(recordedEnd - origin), buffer, jmin(channel, buffer.getNumChannels() - 1),
+            startSample + offset, n);
+    }
+    recordedEnd += n;
+}
+
+void DeckLooper::fadeLoopEnd(AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    const int64 loopEnd = loopStart + loopLength;
+    const int64 fadeStart = loopEnd - crossfadeLength;
+    const int64 from = jmax(position, fadeStart);
+    const int64 to = jmin(position + numSamples, loopEnd);
+
+    //only once the loop will wrap, with the audio leading into its start recorded
+    if (from >= to || loopRecordedEnd < to)
+    {
+        return;
+    }
+
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+    {
+        float* samples = buffer.getWritePointer(channel, startSample + (int)(from - position));
+        const float* leadIn = loopRecording.getReadPointer(jmin(channel, loopRecording.getNumChannels() - 1), (int)(from - fadeStart));
+        for (int i = 0; i < (int)(to - from); ++i)
+        {
+            const int j = (int)(from - fadeStart) + i;
+            samples[i] = samples[i] * fadeInGains[(size_t)(crossfadeLength - 1 - j)] + leadIn[i] * fadeInGains[(size_t)j];
+        }
+    }
+}
+
+void DeckLooper::beginJump(AudioTransportSource& transport)
+{
+    jumpFadeRemaining = 0;
+    if (!transport.isPlaying() || jumpFade.getNumSamples() < crossfadeLength)
+    {
+        return;
+    }
+    render(jumpFade, 0, crossfadeLength, transport);
+    jumpFadeRemaining = crossfadeLength;
+}
@@ -0,0 +1,125 @@
+/*
+  ==============================================================================
+    DeckLooper.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+//===============================================================================
+/*
+    Sits between a deck's transport and its resampler, and plays loops and hot cues from memory.
+    The audio of a loop is recorded as it is played the first time round, and every later pass
+    is read back from the recording, so looping never seeks the transport or touches the decoder.
+    The loop wraps at its exact end sample, crossfaded into the audio just before its start.
+    The first few seconds after each hot cue are recorded the same way, and a jump plays them
+    from memory while the transport is moved on to where the recording ends, giving the
+    read-ahead buffer time to refill. Other jumps are crossfaded from the audio they cut off.
+    Positions are in samples of the track at the device's sample rate, the same as the transport's.
+    All buffers are allocated by prepareToPlay, everything else is called on the audio thread.
+*/
+class DeckLooper
+{
+public:
+
+    enum { numHotCues = 4 };
+
+    DeckLooper();
+    ~DeckLooper();
+
+    //==============================================================================
+    /**Allocate the loop and hot cue recordings for the device, called while it is stopped*/
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate);
+    void releaseResources();
+
+    /**Forget the loop and hot cues, and carry on from the transport's position, when a track is swapped in*/
+    void reset(AudioTransportSource& transport);
+
+    /**Fill the block with the track, from the transport or from memory*/
+    void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill, AudioTransportSource& transport);
+
+    //==============================================================================
+    /**Position in the track of the next sample to be played*/
+    int64 getPosition() const;
+    /**Move the playhead, ending any loop*/
+    void setPosition(int64 newPosition, AudioTransportSource& transport);
+
+    /**Longest loop that fits in memory, in samples*/
+    int64 getMaxLoopLength() const;
+    /**Loop the given length from the start, which must be at least a crossfade ahead of the playhead
+    so the audio leading into it can be recorded*/
+    void setLoop(int64 start, int64 length);
+    /**Change the length of the loop playing, keeping its start. The playhead moves back into a shortened loop*/
+    void setLoopLength(int64 length, AudioTransportSource& transport);
+    /**Stop looping. The track carries on from the playhead without a jump*/
+    void exitLoop();
+    bool isLooping() const;
+    int64 getCrossfadeLength() const;
+
+    /**Place a hot cue at the playhead*/
+    void setHotCue(int index);
+    void clearHotCue(int index);
+    bool hasHotCue(int index) const;
+    /**Jump to a hot cue, playing it from memory if it has been recorded*/
+    void jumpToHotCue(int index, AudioTransportSource& transport);
+
+private:
+    //==============================================================================
+    /**A hot cue and the audio recorded from it*/
+    struct HotCue
+    {
+        bool set = false;
+        int64 position = 0;
+        //end of the audio recorded so far
+        int64 recordedEnd = 0;
+        AudioBuffer<float> recording;
+    };
+
+    /**Fill part of the buffer with the track, switching between the transport and memory as the loop wraps.
+    Records what it plays into the loop and hot cues*/
+    void render(AudioBuffer<float>& buffer, int startSample, int numSamples, AudioTransportSource& transport);
+    /**Copy the part of a block that extends a recording, which always holds contiguous audio from its origin*/
+    static void record(const AudioBuffer<float>& buffer, int startSample, int numSamples, int64 blockPosition,
+        AudioBuffer<float>& recording, int64 origin, int64& recordedEnd, int64 limit);
+    /**Crossfade the last samples of the loop into the audio leading into its start*/
+    void fadeLoopEnd(AudioBuffer<float>& buffer, int startSample, int numSamples);
+    /**Keep the audio the playhead is about to leave, to be faded out over the start of the jump*/
+    void beginJump(AudioTransportSource& transport);
+
+    double sampleRate = 0.0;
+    int crossfadeLength = 0;
+    //rising half of an equal power crossfade, read backwards for the falling half
+    std::vector<float> fadeInGains;
+
+    int64 position = 0;
+    //set when the device is prepared, until the position is taken from the transport again
+    bool positionUnknown = true;
+    //where the transport would carry on from when the audio in memory runs out
+    int64 transportPosition = 0;
+    bool wasPlaying = false;
+
+    //recording being played instead of the transport, holding the track from memoryStart up to memoryEnd
+    const AudioBuffer<float>* memory = nullptr;
+    int64 memoryStart = 0;
+    int memoryOffset = 0;
+    int64 memoryEnd = 0;
+
+    //the loop's recording begins a crossfade before its start
+    bool looping = false;
+    int64 loopStart = 0;
+    int64 loopLength = 0;
+    int64 loopRecordedEnd = 0;
+    AudioBuffer<float> loopRecording;
+
+    HotCue hotCues[numHotCues];
+
+    //audio cut off by the last jump, and how much of it is still to be faded out
+    AudioBuffer<float> jumpFade;
+    int jumpFadeRemaining = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeckLooper)
+};
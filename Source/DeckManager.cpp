@@ -0,0 +1,303 @@
+/*
+  ==============================================================================
+    DeckManager.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "DeckManager.h"
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+namespace
+{
+    //share of a block the audio thread waits for render threads, leaving the rest for the mix and the device
+    const double maxWaitFraction = 0.5;
+    //how long an idle render thread spins for the next block before it starts sleeping between checks
+    const double wakeSpinSeconds = 0.0002;
+
+    /**Tell the core the thread is spinning, so it saves power and frees the core's other hardware thread*/
+    inline void spinPause()
+    {
+       #if JUCE_INTEL
+        _mm_pause();
+       #elif JUCE_ARM && JUCE_MSVC
+        __yield();
+       #elif JUCE_ARM
+        asm volatile("yield");
+       #endif
+    }
+}
+
+//==============================================================================
+/**Waits to be woken by the audio thread, then helps render the block's decks.
+Woken through an atomic counter rather than an event, so waking never takes a lock on the audio thread*/
+class DeckManager::RenderThread : public Thread
+{
+public:
+    RenderThread(DeckManager& _owner, int index)
+        : Thread("Deck render " + String(index)),
+          owner(_owner)
+    {}
+
+    ~RenderThread() override
+    {
+        stopThread(1000);
+    }
+
+    /**Called by the audio thread once a block is ready to render*/
+    void wake()
+    {
+        wakeCount.fetch_add(1);
+    }
+
+    void run() override
+    {
+        uint32 lastWake = wakeCount.load();
+        while (!threadShouldExit())
+        {
+            //spin briefly, as the next block often follows soon after, then sleep between checks
+            const int64 spinUntil = Time::getHighResolutionTicks() + Time::secondsToHighResolutionTicks(wakeSpinSeconds);
+            while (wakeCount.load() == lastWake && !threadShouldExit())
+            {
+                if (Time::getHighResolutionTicks() < spinUntil)
+                {
+                    spinPause();
+                }
+                else
+                {
+                    Thread::sleep(1);
+                }
+            }
+            lastWake = wakeCount.load();
+
+            if (!threadShouldExit())
+            {
+                owner.renderUnclaimedDecks();
+            }
+        }
+    }
+
+private:
+    DeckManager& owner;
+    std::atomic<uint32> wakeCount{ 0 };
+};
+
+
+//==============================================================================
+DeckManager::DeckManager(int numDecks,
+    AudioFormatManager& formatManager,
+    TimeSliceThread& diskThread,
+    DecodedTrackCache& decodedTracks,
+    PcmFileCache& pcmCache)
+    : mixer(numDecks),
+      deckSlots(new DeckSlot[(size_t)numDecks])
+{
+    for (int i = 0; i < numDecks; ++i)
+    {
+        players.add(new DJAudioPlayer(formatManager, diskThread, decodedTracks, pcmCache));
+    }
+    //nothing to claim until the first block
+    nextDeckToRender = numDecks;
+
+    //the audio thread renders decks too, so one thread fewer than the decks or cores is enough
+    const int numRenderThreads = jmin(numDecks, SystemStats::getNumCpus()) - 1;
+    for (int i = 0; i < numRenderThreads; ++i)
+    {
+        RenderThread* thread = renderThreads.add(new RenderThread(*this, i + 1));
+        //the highest priority, which is realtime scheduling where the platform allows it
+        thread->startThread(10);
+    }
+}
+
+DeckManager::~DeckManager()
+{
+    //stop the render threads before the players they render are deleted
+    renderThreads.clear();
+}
+
+//==============================================================================
+void DeckManager::prepareToPlay(int samplesPerBlockExpected, double _sampleRate)
+{
+    //a render thread may still be finishing a deck from the last block before the device stopped
+    waitForRenderThreads();
+
+    deckBufferSize = samplesPerBlockExpected;
+    sampleRate = _sampleRate;
+    deckRendered.assign((size_t)players.size(), false);
+    deckBuffers.resize((size_t)players.size());
+    for (AudioBuffer<float>& buffer : deckBuffers)
+    {
+        buffer.setSize(2, deckBufferSize);
+    }
+
+    for (DJAudioPlayer* player : players)
+    {
+        player->prepareToPlay(samplesPerBlockExpected, _sampleRate);
+    }
+    mixer.prepareToPlay(samplesPerBlockExpected, _sampleRate);
+}
+
+void DeckManager::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
+{
+    bufferToFill.clearActiveBufferRegion();
+    if (deckBufferSize == 0)
+    {
+        return;
+    }
+
+    const bool renderInParallel = !renderThreads.isEmpty()
+        && bufferToFill.numSamples >= minimumParallelBlockSize.load();
+
+    //blocks longer than the device promised are rendered in pieces, so nothing is allocated here
+    for (int start = 0; start < bufferToFill.numSamples; start += deckBufferSize)
+    {
+        const int numSamples = jmin(deckBufferSize, bufferToFill.numSamples - start);
+        const int64 block = blockToRender.load() + 1;
+        const int64 deadline = Time::getHighResolutionTicks()
+            + (int64)(maxWaitFraction * numSamples / sampleRate * Time::getHighResolutionTicksPerSecond());
+
+        //published first, so a thread still finishing a deck from an earlier block cannot start another
+        numSamplesToRender.store(numSamples);
+        blockToRender.store(block);
+
+        //every deck is between blocks here, so the decks in sync all follow the master from the same point in time.
+        //No thread can start on a deck until the counter is reset below, but one left out of an earlier block may
+        //still be rendering. It keeps the clock it has, and a master still rendering leaves its last clock in use
+        const int master = syncMaster.load();
+        if (!deckSlots[(size_t)master].busy.load())
+        {
+            masterClock = players.getUnchecked(master)->getBeatClock();
+        }
+        for (int deckIndex = 0; deckIndex < players.size(); ++deckIndex)
+        {
+            if (!deckSlots[(size_t)deckIndex].busy.load())
+            {
+                players.getUnchecked(deckIndex)->setSyncMaster(deckIndex != master ? masterClock : DJAudioPlayer::BeatClock());
+            }
+        }
+
+        nextDeckToRender.store(0);
+
+        if (renderInParallel)
+        {
+            for (RenderThread* thread : renderThreads)
+            {
+                thread->wake();
+            }
+        }
+        renderUnclaimedDecks();
+
+        //a deck claimed by a thread that has not started on it yet is rendered here straight away
+        for (int deckIndex = 0; deckIndex < players.size(); ++deckIndex)
+        {
+            renderDeck(deckIndex, block, numSamples);
+        }
+
+        //then wait for the decks still being rendered, but only until the deadline. One that was busy with an
+        //earlier block and finishes in time is rendered here, one still being rendered is left out
+        for (int deckIndex = 0; deckIndex < players.size(); ++deckIndex)
+        {
+            const DeckSlot& slot = deckSlots[(size_t)deckIndex];
+            while (slot.renderedBlock.load() != block && slot.busy.load()
+                && Time::getHighResolutionTicks() < deadline)
+            {
+                spinPause();
+            }
+            renderDeck(deckIndex, block, numSamples);
+            deckRendered[(size_t)deckIndex] = slot.renderedBlock.load() == block;
+        }
+
+        mixer.sumDecks(deckBuffers, deckRendered, *bufferToFill.buffer, bufferToFill.startSample + start, numSamples);
+    }
+}
+
+void DeckManager::releaseResources()
+{
+    waitForRenderThreads();
+    for (DJAudioPlayer* player : players)
+    {
+        player->releaseResources();
+    }
+}
+
+//==============================================================================
+int DeckManager::getNumDecks() const
+{
+    return players.size();
+}
+
+DJAudioPlayer* DeckManager::getPlayer(int deckIndex) const
+{
+    return players[deckIndex];
+}
+
+DeckMixer& DeckManager::getMixer()
+{
+    return mixer;
+}
+
+void DeckManager::setMinimumParallelBlockSize(int numSamples)
+{
+    minimumParallelBlockSize = numSamples;
+}
+
+void DeckManager::setSyncMaster(int deckIndex)
+{
+    syncMaster = jlimit(0, players.size() - 1, deckIndex);
+}
+
+int DeckManager::getSyncMaster() const
+{
+    return syncMaster.load();
+}
+
+void DeckManager::waitForRenderThreads()
+{
+    //moving the block on turns down any claim made before now, so only a deck already started has to finish
+    blockToRender.fetch_add(1);
+    for (int deckIndex = 0; deckIndex < players.size(); ++deckIndex)
+    {
+        while (deckSlots[(size_t)deckIndex].busy.load())
+        {
+            Thread::yield();
+        }
+    }
+}
+
+void DeckManager::renderUnclaimedDecks()
+{
+    for (;;)
+    {
+        //read before claiming, so a claim made as a new block starts is turned down by renderDeck
+        const int64 block = blockToRender.load();
+        const int numSamples = numSamplesToRender.load();
+        const int deckIndex = nextDeckToRender.fetch_add(1);
+        if (deckIndex >= players.size())
+        {
+            return;
+        }
+        renderDeck(deckIndex, block, numSamples);
+    }
+}
+
+void DeckManager::renderDeck(int deckIndex, int64 block, int numSamples)
+{
+    DeckSlot& slot = deckSlots[(size_t)deckIndex];
+    if (slot.renderedBlock.load() == block || slot.busy.exchange(true))
+    {
+        return;
+    }
+
+    //checked again now the deck is held, in case the block has moved on or another thread finished it in between
+    if (blockToRender.load() == block && slot.renderedBlock.load() != block)
+    {
+        //the channel strip runs on the same thread, so EQ scales with the decks
+        AudioSourceChannelInfo info(&deckBuffers[(size_t)deckIndex], 0, numSamples);
+        players.getUnchecked(deckIndex)->getNextAudioBlock(info);
+        mixer.processDeck(deckIndex, deckBuffers[(size_t)deckIndex], numSamples);
+        slot.renderedBlock.store(block);
+    }
+    slot.busy.store(false);
+}
@@ -0,0 +1,109 @@
+/*
+  ==============================================================================
+    DeckManager.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "DJAudioPlayer.h"
+#include "DeckMixer.h"
+#include <atomic>
+#include <vector>
+
+//===============================================================================
+/*
+    Owns the players for a configurable number of decks and mixes them together.
+    Each deck renders into its own buffer and through its channel strip, and when the block
+    is long enough the decks are shared out between the audio thread and a pool of high
+    priority render threads, so the mix scales across cores rather than running every deck in turn. The render threads
+    are woken without a lock and decks are claimed with an atomic counter, so the audio thread never waits for a render
+    thread that has not started on a deck yet, rendering it itself, only for one already part way through a deck, and
+    then only until a deadline part way through the block. A deck still unfinished then is left out of the block
+    rather than missing the callback.
+    Before each block, the clock of the sync master is handed to the other decks, so those in sync
+    follow its beats without waiting for it to render.
+*/
+class DeckManager : public AudioSource
+{
+public:
+
+    /**Players are created for numDecks decks, sharing the disk thread and caches*/
+    DeckManager(int numDecks,
+        AudioFormatManager& formatManager,
+        TimeSliceThread& diskThread,
+        DecodedTrackCache& decodedTracks,
+        PcmFileCache& pcmCache);
+    ~DeckManager() override;
+
+    //==============================================================================
+    /**Override of AudioSource pure virtual. Prepares every player, and allocates a buffer for each deck*/
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    /**Override of AudioSource pure virtual. Renders every deck, in parallel where worthwhile, and mixes them*/
+    void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override;
+    /**Override of AudioSource pure virtual*/
+    void releaseResources() override;
+
+    //==============================================================================
+    int getNumDecks() const;
+    /**Player for the deck at deckIndex, from 0 to getNumDecks() - 1*/
+    DJAudioPlayer* getPlayer(int deckIndex) const;
+    /**Channel strips and crossfader the decks are mixed through*/
+    DeckMixer& getMixer();
+
+    /**Blocks shorter than this are rendered by the audio thread alone, where waking the
+    render threads would cost more than it saves*/
+    void setMinimumParallelBlockSize(int numSamples);
+
+    /**Deck whose tempo and beats the decks in sync follow*/
+    void setSyncMaster(int deckIndex);
+    int getSyncMaster() const;
+
+private:
+    //==============================================================================
+    class RenderThread;
+
+    /**Stop render threads starting on any more decks, and wait for those part way through one. Not for the audio thread*/
+    void waitForRenderThreads();
+    /**Render decks until none are left unclaimed, called by the audio thread and the render threads*/
+    void renderUnclaimedDecks();
+    /**Render one deck for the block, unless it has been already or another thread is still busy with it*/
+    void renderDeck(int deckIndex, int64 block, int numSamples);
+
+    /**Rendering state of a deck, shared between the threads*/
+    struct DeckSlot
+    {
+        //set while a thread is rendering the deck, which may run on past the block it started in
+        std::atomic<bool> busy{ false };
+        //last block the deck was rendered for
+        std::atomic<int64> renderedBlock{ -1 };
+    };
+
+    OwnedArray<DJAudioPlayer> players;
+    DeckMixer mixer;
+    OwnedArray<RenderThread> renderThreads;
+
+    //output of each deck for the current block, allocated in prepareToPlay
+    std::vector<AudioBuffer<float>> deckBuffers;
+    int deckBufferSize = 0;
+    double sampleRate = 0.0;
+    std::unique_ptr<DeckSlot[]> deckSlots;
+    //which decks made it into the current block, audio thread only
+    std::vector<bool> deckRendered;
+
+    //the block being rendered. The block number and sample count are written before the deck counter is reset,
+    //and read before a deck is claimed from it
+    std::atomic<int64> blockToRender{ 0 };
+    std::atomic<int> numSamplesToRender{ 0 };
+    std::atomic<int> nextDeckToRender{ 0 };
+
+    std::atomic<int> minimumParallelBlockSize{ 256 };
+
+    std::atomic<int> syncMaster{ 0 };
+    //clock of the sync master handed to the other decks, kept from the last block while the master is still rendering
+    DJAudioPlayer::BeatClock masterClock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeckManager)
+};
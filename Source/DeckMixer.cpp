@@ -0,0 +1,252 @@
+/*
+  ==============================================================================
+    DeckMixer.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "DeckMixer.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    //controls settle to within a few percent of a change in about this long
+    const double smoothingSeconds = 0.02;
+
+    //centre frequencies of the EQ bands
+    const double lowFrequency = 200.0;
+    const double midFrequency = 1000.0;
+    const double highFrequency = 4000.0;
+
+    /**Move value a fraction of the way towards target, arriving once it is close enough not to be heard*/
+    float moveTowards(float value, float target, float fraction, float closeEnough)
+    {
+        value += (target - value) * fraction;
+        return std::abs(target - value) < closeEnough ? target : value;
+    }
+}
+
+DeckMixer::DeckMixer(int numDecks)
+{
+    for (int i = 0; i < numDecks; ++i)
+    {
+        ChannelStrip* strip = strips.add(new ChannelStrip());
+        for (int band = 0; band < numBands; ++band)
+        {
+            strip->eqDecibels[band] = 0.0f;
+            strip->currentEqDecibels[band] = 0.0f;
+        }
+    }
+}
+
+DeckMixer::~DeckMixer()
+{}
+
+//==============================================================================
+void DeckMixer::prepareToPlay(int samplesPerBlockExpected, double _sampleRate)
+{
+    sampleRate = _sampleRate;
+
+    //the device is stopped, so the strips can be put straight to their settings
+    for (ChannelStrip* strip : strips)
+    {
+        strip->blockStartGain = 0.0f;
+        strip->blockEndGain = 0.0f;
+        strip->cueStartGain = 0.0f;
+        strip->cueEndGain = 0.0f;
+        strip->trimGain = Decibels::decibelsToGain(strip->trimDecibels.load());
+        strip->eqActive = false;
+        for (int band = 0; band < numBands; ++band)
+        {
+            strip->currentEqDecibels[band] = strip->eqDecibels[band].load();
+            strip->eqCoefficients[band] = makeEqCoefficients(band, strip->currentEqDecibels[band]);
+        }
+    }
+}
+
+void DeckMixer::processDeck(int deckIndex, AudioBuffer<float>& deckBuffer, int numSamples)
+{
+    ScopedNoDenormals noDenormals;
+    ChannelStrip& strip = *strips.getUnchecked(deckIndex);
+    const float fraction = (float)(1.0 - std::exp(-numSamples / (sampleRate * smoothingSeconds)));
+
+    //trim first, so the EQ sees the level it is set for. Left out at unity gain
+    const float trimTarget = Decibels::decibelsToGain(strip.trimDecibels.load(std::memory_order_relaxed));
+    const float trimStartGain = strip.trimGain;
+    strip.trimGain = moveTowards(strip.trimGain, trimTarget, fraction, 0.0001f);
+    if (trimStartGain != 1.0f || strip.trimGain != 1.0f)
+    {
+        for (int channel = 0; channel < jmin(2, deckBuffer.getNumChannels()); ++channel)
+        {
+            deckBuffer.applyGainRamp(channel, 0, numSamples, trimStartGain, strip.trimGain);
+        }
+    }
+
+    //EQ, left out while every band is flat
+    bool eqFlat = true;
+    for (int band = 0; band < numBands; ++band)
+    {
+        const float target = strip.eqDecibels[band].load(std::memory_order_relaxed);
+        const float decibels = moveTowards(strip.currentEqDecibels[band], target, fraction, 0.01f);
+        if (decibels != strip.currentEqDecibels[band])
+        {
+            strip.currentEqDecibels[band] = decibels;
+            strip.eqCoefficients[band] = makeEqCoefficients(band, decibels);
+        }
+        eqFlat = eqFlat && decibels == 0.0f;
+    }
+
+    if (!eqFlat && !strip.eqActive)
+    {
+        //state left from the last time the EQ was used would click
+        std::memset(strip.eqState, 0, sizeof(strip.eqState));
+    }
+    strip.eqActive = !eqFlat;
+
+    if (strip.eqActive)
+    {
+        for (int channel = 0; channel < jmin(2, deckBuffer.getNumChannels()); ++channel)
+        {
+            float* samples = deckBuffer.getWritePointer(channel);
+            for (int band = 0; band < numBands; ++band)
+            {
+                //transposed direct form II
+                const float* c = strip.eqCoefficients[band].coefficients;
+                float z1 = strip.eqState[band][channel][0];
+                float z2 = strip.eqState[band][channel][1];
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    const float in = samples[i];
+                    const float out = c[0] * in + z1;
+                    z1 = c[1] * in - c[3] * out + z2;
+                    z2 = c[2] * in - c[4] * out;
+                    samples[i] = out;
+                }
+                strip.eqState[band][channel][0] = z1;
+                strip.eqState[band][channel][1] = z2;
+            }
+        }
+    }
+
+    //fader and crossfader make up one gain, ramped over the block
+    const float targetGain = strip.fader.load(std::memory_order_relaxed)
+        * getCrossfaderGain(strip.crossfaderSide.load(std::memory_order_relaxed),
+            crossfader.load(std::memory_order_relaxed),
+            crossfaderCurve.load(std::memory_order_relaxed));
+    strip.blockStartGain = strip.blockEndGain;
+    strip.blockEndGain = moveTowards(strip.blockEndGain, targetGain, fraction, 0.0001f);
+
+    //the cue bus blends the deck before its fader with its share of the master, as one gain
+    const float masterProportion = cueMix.load(std::memory_order_relaxed);
+    const float cueGain = strip.cue.load(std::memory_order_relaxed) ? 1.0f : 0.0f;
+    const float targetCueGain = cueGain * (1.0f - masterProportion) + targetGain * masterProportion;
+    strip.cueStartGain = strip.cueEndGain;
+    strip.cueEndGain = moveTowards(strip.cueEndGain, targetCueGain, fraction, 0.0001f);
+}
+
+void DeckMixer::sumDecks(const std::vector<AudioBuffer<float>>& deckBuffers, const std::vector<bool>& deckRendered,
+    AudioBuffer<float>& output, int outputStart, int numSamples)
+{
+    //master on the first pair of outputs, cue on the second if the device has one
+    const int numMasterChannels = jmin(2, output.getNumChannels());
+    const bool hasCueBus = output.getNumChannels() >= 4;
+
+    for (int deckIndex = 0; deckIndex < strips.size(); ++deckIndex)
+    {
+        //its render thread may still be writing the buffer and the gains
+        if (!deckRendered[(size_t)deckIndex])
+        {
+            continue;
+        }
+        const ChannelStrip& strip = *strips.getUnchecked(deckIndex);
+        const AudioBuffer<float>& deckBuffer = deckBuffers[(size_t)deckIndex];
+
+        for (int channel = 0; channel < numMasterChannels; ++channel)
+        {
+            const float* source = deckBuffer.getReadPointer(jmin(channel, deckBuffer.getNumChannels() - 1));
+            output.addFromWithRamp(channel, outputStart, source, numSamples, strip.blockStartGain, strip.blockEndGain);
+            if (hasCueBus)
+            {
+                output.addFromWithRamp(channel + 2, outputStart, source, numSamples, strip.cueStartGain, strip.cueEndGain);
+            }
+        }
+    }
+}
+
+//==============================================================================
+void DeckMixer::setTrim(int deckIndex, float decibels)
+{
+    strips[deckIndex]->trimDecibels = decibels;
+}
+
+void DeckMixer::setEqGain(int deckIndex, Band band, float decibels)
+{
+    strips[deckIndex]->eqDecibels[band] = decibels;
+}
+
+void DeckMixer::setFader(int deckIndex, float level)
+{
+    strips[deckIndex]->fader = jlimit(0.0f, 1.0f, level);
+}
+
+void DeckMixer::setCrossfaderSide(int deckIndex, CrossfaderSide side)
+{
+    strips[deckIndex]->crossfaderSide = side;
+}
+
+void DeckMixer::setCue(int deckIndex, bool shouldCue)
+{
+    strips[deckIndex]->cue = shouldCue;
+}
+
+void DeckMixer::setCrossfader(float position)
+{
+    crossfader = jlimit(0.0f, 1.0f, position);
+}
+
+void DeckMixer::setCrossfaderCurve(CrossfaderCurve curve)
+{
+    crossfaderCurve = curve;
+}
+
+void DeckMixer::setCueMix(float masterProportion)
+{
+    cueMix = jlimit(0.0f, 1.0f, masterProportion);
+}
+
+//==============================================================================
+float DeckMixer::getCrossfaderGain(int side, float position, int curve)
+{
+    if (side == thru)
+    {
+        return 1.0f;
+    }
+
+    //distance of the crossfader from this deck's end, 0 at its own end and 1 at the other
+    const float distance = side == sideA ? position : 1.0f - position;
+    switch (curve)
+    {
+    case linearCurve:
+        return 1.0f - distance;
+    case cutCurve:
+        return jmin(1.0f, (1.0f - distance) * 20.0f);
+    case constantPowerCurve:
+    default:
+        return std::cos(distance * MathConstants<float>::halfPi);
+    }
+}
+
+IIRCoefficients DeckMixer::makeEqCoefficients(int band, float decibels) const
+{
+    const float gain = Decibels::decibelsToGain(decibels, -100.0f);
+    if (band == low)
+    {
+        return IIRCoefficients::makeLowShelf(sampleRate, lowFrequency, 0.7, gain);
+    }
+    if (band == mid)
+    {
+        return IIRCoefficients::makePeakFilter(sampleRate, midFrequency, 0.7, gain);
+    }
+    return IIRCoefficients::makeHighShelf(sampleRate, highFrequency, 0.7, gain);
+}
@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+    DeckMixer.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+
+//===============================================================================
+/*
+    Channel strip for every deck, with trim, a three band EQ, a fader and a side of the
+    crossfader, and the sum of the strips into the output.
+    With four or more outputs, the first pair is the master bus and the second is the cue bus
+    for headphones, which blends the decks being cued before their faders with the master.
+    Each deck is added to both buses in the same pass, so the cue bus costs one more
+    accumulate per deck.
+    Controls are set from the message thread through atomics, and the audio thread moves
+    towards them a block at a time, so nothing is locked and nothing jumps. Nothing is
+    allocated once the strips have been created.
+*/
+class DeckMixer
+{
+public:
+
+    /**Bands of each deck's EQ*/
+    enum Band
+    {
+        low,
+        mid,
+        high,
+        numBands
+    };
+
+    /**Which end of the crossfader a deck is heard at, or thru to ignore the crossfader*/
+    enum CrossfaderSide
+    {
+        sideA,
+        thru,
+        sideB
+    };
+
+    /**How the decks fade as the crossfader moves. Linear dips in the middle, constant power keeps
+    the overall level, and cut only fades over the last few percent for scratching*/
+    enum CrossfaderCurve
+    {
+        linearCurve,
+        constantPowerCurve,
+        cutCurve
+    };
+
+    DeckMixer(int numDecks);
+    ~DeckMixer();
+
+    //==============================================================================
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate);
+
+    /**Apply the EQ of the deck at deckIndex to its buffer in place, and work out the deck's gain
+    for the block. Called from whichever thread rendered the deck*/
+    void processDeck(int deckIndex, AudioBuffer<float>& deckBuffer, int numSamples);
+    /**Add every processed deck to the master bus at its gain, and to the cue bus if the output
+    has one, on the audio thread. Decks not rendered in time for the block are left out*/
+    void sumDecks(const std::vector<AudioBuffer<float>>& deckBuffers, const std::vector<bool>& deckRendered,
+        AudioBuffer<float>& output, int outputStart, int numSamples);
+
+    //==============================================================================
+    /**Gain before the EQ, in decibels*/
+    void setTrim(int deckIndex, float decibels);
+    /**Boost or cut of one band of the EQ, in decibels*/
+    void setEqGain(int deckIndex, Band band, float decibels);
+    /**Level of the deck's fader, from 0 to 1*/
+    void setFader(int deckIndex, float level);
+    void setCrossfaderSide(int deckIndex, CrossfaderSide side);
+    /**Whether the deck is heard on the cue bus, before its fader and the crossfader*/
+    void setCue(int deckIndex, bool shouldCue);
+
+    /**Position of the crossfader, from 0 for side A to 1 for side B*/
+    void setCrossfader(float position);
+    void setCrossfaderCurve(CrossfaderCurve curve);
+    /**Blend of the cue bus, from 0 for only the decks being cued to 1 for only the master*/
+    void setCueMix(float masterProportion);
+
+private:
+    //==============================================================================
+    /**Controls and audio thread state of one deck*/
+    struct ChannelStrip
+    {
+        //set by the message thread
+        std::atomic<float> trimDecibels{ 0.0f };
+        std::atomic<float> eqDecibels[numBands];
+        std::atomic<float> fader{ 1.0f };
+        std::atomic<int> crossfaderSide{ thru };
+        std::atomic<bool> cue{ false };
+
+        //used by the thread processing the deck. The gains are ramped from start to end over the block
+        float trimGain = 1.0f;
+        float blockStartGain = 0.0f;
+        float blockEndGain = 0.0f;
+        float cueStartGain = 0.0f;
+        float cueEndGain = 0.0f;
+        float currentEqDecibels[numBands];
+        bool eqActive = false;
+
+        //biquad coefficients for the EQ as it is now, and two samples of state per band and channel
+        IIRCoefficients eqCoefficients[numBands];
+        float eqState[numBands][2][2];
+    };
+
+    /**Gain of a deck on the given side for the crossfader position and curve*/
+    static float getCrossfaderGain(int side, float position, int curve);
+    /**Work out the EQ coefficients for the given gain of a band*/
+    IIRCoefficients makeEqCoefficients(int band, float decibels) const;
+
+    OwnedArray<ChannelStrip> strips;
+
+    std::atomic<float> crossfader{ 0.5f };
+    std::atomic<int> crossfaderCurve{ constantPowerCurve };
+    std::atomic<float> cueMix{ 0.0f };
+
+    double sampleRate = 44100.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeckMixer)
+};
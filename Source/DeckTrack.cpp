@@ -0,0 +1,111 @@
+/*
+  ==============================================================================
+    DeckTrack.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "DeckTrack.h"
+
+DeckTrack::DeckTrack(AudioFormatReader* reader,
+    TimeSliceThread& diskThread,
+    int readAheadSamples,
+    std::atomic<int>& underrunCounter)
+    : readerSource(new AudioFormatReaderSource(reader, true)),
+      lengthInSeconds(reader->lengthInSamples / reader->sampleRate)
+{
+    //the buffer is filled by the disk thread shared by all decks, never by the audio callback
+    readTracker.reset(new ReadTrackingSource(*readerSource, readAheadSamples));
+    bufferingSource.reset(new BufferingAudioSource(readTracker.get(), diskThread, false, readAheadSamples, 2));
+    monitoredSource.reset(new MonitoredBufferSource(*bufferingSource, *readTracker, underrunCounter));
+    transportSource.setSource(monitoredSource.get(), 0, nullptr, reader->sampleRate);
+}
+
+DeckTrack::DeckTrack(DecodedTrackCache::TrackPtr decodedTrack)
+    : pcmSource(new PcmBufferSource(decodedTrack)),
+      lengthInSeconds(decodedTrack->audio.getNumSamples() / decodedTrack->sampleRate)
+{
+    transportSource.setSource(pcmSource.get(), 0, nullptr, decodedTrack->sampleRate);
+}
+
+DeckTrack::~DeckTrack()
+{
+    transportSource.setSource(nullptr);
+}
+
+//==============================================================================
+void DeckTrack::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    transportSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
+    preparedSampleRate = sampleRate;
+}
+
+void DeckTrack::releaseResources()
+{
+    transportSource.releaseResources();
+    preparedSampleRate = 0.0;
+}
+
+
+//==============================================================================
+void DeckTrack::ReadTrackingSource::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    //the buffer is sized the same way, and starts again empty
+    bufferSamples = jmax(samplesPerBlockExpected * 2, readAheadSamples);
+    publish(0, 0);
+    source.prepareToPlay(samplesPerBlockExpected, sampleRate);
+}
+
+void DeckTrack::ReadTrackingSource::releaseResources()
+{
+    publish(0, 0);
+    source.releaseResources();
+}
+
+void DeckTrack::ReadTrackingSource::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
+{
+    const int64 start = source.getNextReadPosition();
+
+    //a section not following on from the last one means the buffer has thrown away what it held
+    if (start != readEnd.load())
+    {
+        publish(start, start);
+    }
+    source.getNextAudioBlock(bufferToFill);
+
+    //samples further back than the buffer's size have been overwritten
+    const int64 end = start + bufferToFill.numSamples;
+    publish(jmax(readStart.load(), end - bufferSamples.load()), end);
+}
+
+bool DeckTrack::ReadTrackingSource::hasRead(int64 start, int numSamples) const
+{
+    const uint32 before = sequence.load();
+    const int64 rangeStart = readStart.load();
+    const int64 rangeEnd = readEnd.load();
+
+    //caught in the middle of a change, which only takes a moment, so given the benefit of the doubt
+    if ((before & 1) != 0 || sequence.load() != before)
+    {
+        return true;
+    }
+    return start >= rangeStart && start + numSamples <= rangeEnd;
+}
+
+void DeckTrack::ReadTrackingSource::publish(int64 start, int64 end)
+{
+    ++sequence;
+    readStart = start;
+    readEnd = end;
+    ++sequence;
+}
+
+void DeckTrack::MonitoredBufferSource::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
+{
+    //the buffer plays silence for anything the disk thread has not read yet
+    if (!readTracker.hasRead(buffer.getNextReadPosition(), bufferToFill.numSamples))
+    {
+        ++underrunCounter;
+    }
+    buffer.getNextAudioBlock(bufferToFill);
+}
@@ -0,0 +1,135 @@
+/*
+  ==============================================================================
+    DeckTrack.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "DecodedTrackCache.h"
+#include "PcmBufferSource.h"
+#include <atomic>
+
+//===============================================================================
+/*
+    A track opened for playback on a deck, and the transport playing it.
+    The track is either streamed from the file's reader through a read-ahead buffer filled
+    by the shared disk thread, or played from a copy decoded entirely into memory.
+    Tracks are created and prepared on a background thread, then handed to the deck's
+    audio thread, which is the only thread using them until they are retired.
+*/
+class DeckTrack
+{
+public:
+
+    /**Takes ownership of the reader. The buffer is filled ahead of the playhead by the disk thread,
+    and every block the buffer could not supply in time is added to the underrun counter*/
+    DeckTrack(AudioFormatReader* reader,
+        TimeSliceThread& diskThread,
+        int readAheadSamples,
+        std::atomic<int>& underrunCounter);
+    /**Plays the decoded track from memory, without a reader or disk access*/
+    DeckTrack(DecodedTrackCache::TrackPtr decodedTrack);
+    ~DeckTrack();
+
+    //==============================================================================
+    /**Prepare the transport for the device's block size and sample rate, and fill the read-ahead buffer.
+    Called before the track is handed to the audio thread, or while the device is stopped*/
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate);
+    /**Release anything the transport no longer needs*/
+    void releaseResources();
+    /**True if the track was last prepared for the given sample rate*/
+    bool isPreparedFor(double sampleRate) const { return preparedSampleRate == sampleRate; }
+
+    //==============================================================================
+    AudioTransportSource& getTransport() { return transportSource; }
+    double getLengthInSeconds() const { return lengthInSeconds; }
+    /**True if the track is played from memory rather than streamed from disk*/
+    bool isRamResident() const { return pcmSource != nullptr; }
+
+    /**Beat grid from the library's analysis, set before the track is handed to the audio thread.
+    A tempo of 0 means the track has no grid*/
+    void setBeatGrid(double _bpm, double _firstBeatSeconds) { bpm = _bpm; firstBeatSeconds = _firstBeatSeconds; }
+    double getBpm() const { return bpm; }
+    double getFirstBeatSeconds() const { return firstBeatSeconds; }
+
+private:
+    //==============================================================================
+    /**Sits between the reader and the read-ahead buffer, and publishes the range of the track the disk thread
+    has read into the buffer, so the audio thread can tell whether a block is ready without taking the buffer's lock*/
+    class ReadTrackingSource : public PositionableAudioSource
+    {
+    public:
+        ReadTrackingSource(AudioFormatReaderSource& _source, int _readAheadSamples)
+            : source(_source), readAheadSamples(_readAheadSamples) {}
+
+        void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+        void releaseResources() override;
+        /**Called on the disk thread for every section it reads*/
+        void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override;
+
+        void setNextReadPosition(int64 newPosition) override { source.setNextReadPosition(newPosition); }
+        int64 getNextReadPosition() const override { return source.getNextReadPosition(); }
+        int64 getTotalLength() const override { return source.getTotalLength(); }
+        bool isLooping() const override { return source.isLooping(); }
+        void setLooping(bool shouldLoop) override { source.setLooping(shouldLoop); }
+
+        /**True if the buffer holds the given samples. Lock-free, called on the audio thread*/
+        bool hasRead(int64 start, int numSamples) const;
+
+    private:
+        /**Publish a new range, bracketed by the sequence count so a reader never sees half of it*/
+        void publish(int64 start, int64 end);
+
+        AudioFormatReaderSource& source;
+        const int readAheadSamples;
+        //the buffer keeps no more than this many samples behind the end of what it has read
+        std::atomic<int64> bufferSamples{ 0 };
+
+        //odd while the range is being changed
+        std::atomic<uint32> sequence{ 0 };
+        std::atomic<int64> readStart{ 0 };
+        std::atomic<int64> readEnd{ 0 };
+    };
+
+    /**Passes audio through from the read-ahead buffer, counting the blocks it could not supply in time*/
+    class MonitoredBufferSource : public PositionableAudioSource
+    {
+    public:
+        MonitoredBufferSource(BufferingAudioSource& _buffer, const ReadTrackingSource& _readTracker, std::atomic<int>& _underrunCounter)
+            : buffer(_buffer), readTracker(_readTracker), underrunCounter(_underrunCounter) {}
+
+        void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override { buffer.prepareToPlay(samplesPerBlockExpected, sampleRate); }
+        void releaseResources() override { buffer.releaseResources(); }
+        void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override;
+
+        void setNextReadPosition(int64 newPosition) override { buffer.setNextReadPosition(newPosition); }
+        int64 getNextReadPosition() const override { return buffer.getNextReadPosition(); }
+        int64 getTotalLength() const override { return buffer.getTotalLength(); }
+        bool isLooping() const override { return buffer.isLooping(); }
+        void setLooping(bool shouldLoop) override { buffer.setLooping(shouldLoop); }
+
+    private:
+        BufferingAudioSource& buffer;
+        const ReadTrackingSource& readTracker;
+        std::atomic<int>& underrunCounter;
+    };
+
+    //==============================================================================
+    std::unique_ptr<AudioFormatReaderSource> readerSource;
+    std::unique_ptr<ReadTrackingSource> readTracker;
+    std::unique_ptr<BufferingAudioSource> bufferingSource;
+    std::unique_ptr<MonitoredBufferSource> monitoredSource;
+    std::unique_ptr<PcmBufferSource> pcmSource;
+    AudioTransportSource transportSource;
+
+    double lengthInSeconds;
+    double preparedSampleRate = 0.0;
+
+    double bpm = 0.0;
+    double firstBeatSeconds = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeckTrack)
+};
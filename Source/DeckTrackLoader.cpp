@@ -0,0 +1,193 @@
+/*
+  ==============================================================================
+    DeckTrackLoader.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "DeckTrackLoader.h"
+
+DeckTrackLoader::DeckTrackLoader(AudioFormatManager& _formatManager,
+    TimeSliceThread& _diskThread,
+    DecodedTrackCache& _decodedTracks,
+    PcmFileCache& _pcmCache,
+    std::atomic<int>& _underrunCounter)
+    : Thread("DeckTrackLoader"),
+      formatManager(_formatManager),
+      diskThread(_diskThread),
+      decodedTracks(_decodedTracks),
+      pcmCache(_pcmCache),
+      underrunCounter(_underrunCounter)
+{
+    startThread();
+}
+
+DeckTrackLoader::~DeckTrackLoader()
+{
+    cancelPendingUpdate();
+    stopThread(5000);
+    deleteRetiredTracks();
+}
+
+//==============================================================================
+void DeckTrackLoader::load(const URL& audioURL, int samplesPerBlockExpected, double sampleRate, int readAheadSamples, bool ramResident,
+    bool asNextTrack)
+{
+    {
+        const ScopedLock sl(requestLock);
+        Request& request = requests[asNextTrack ? 1 : 0];
+        request.pending = true;
+        request.audioURL = audioURL;
+        request.blockSize = samplesPerBlockExpected;
+        request.sampleRate = sampleRate;
+        request.readAhead = readAheadSamples;
+        request.ramResident = ramResident;
+    }
+    notify();
+}
+
+bool DeckTrackLoader::retireTrack(DeckTrack* track)
+{
+    int start1, size1, start2, size2;
+    retiredFifo.prepareToWrite(1, start1, size1, start2, size2);
+    if (size1 + size2 < 1)
+    {
+        return false;
+    }
+
+    retiredTracks[size1 > 0 ? start1 : start2] = track;
+    retiredFifo.finishedWrite(1);
+    return true;
+}
+
+
+//==============================================================================
+void DeckTrackLoader::run()
+{
+    while (!threadShouldExit())
+    {
+        deleteRetiredTracks();
+
+        //the track to play first, as the user is waiting for it
+        for (int slot = 0; slot < 2; ++slot)
+        {
+            Request request;
+            {
+                const ScopedLock sl(requestLock);
+                request = requests[slot];
+                requests[slot].pending = false;
+            }
+            if (!request.pending)
+            {
+                continue;
+            }
+
+            std::unique_ptr<DeckTrack> track(openTrack(request.audioURL, request.readAhead, request.ramResident));
+
+            //preparing fills the read-ahead buffer, so the track can start playing without waiting.
+            //The device may not have started yet, the deck prepares the track when it does
+            if (track != nullptr && request.sampleRate > 0)
+            {
+                track->prepareToPlay(request.blockSize, request.sampleRate);
+            }
+
+            {
+                const ScopedLock sl(resultLock);
+                results[slot].track = std::move(track);
+                results[slot].audioURL = request.audioURL;
+                results[slot].ready = true;
+            }
+            triggerAsyncUpdate();
+        }
+
+        //the audio thread cannot wake this thread without locking, so check for retired tracks regularly
+        wait(100);
+    }
+}
+
+DeckTrack* DeckTrackLoader::openTrack(const URL& audioURL, int readAheadSamples, bool ramResident)
+{
+    //a recently played track is still decoded in memory, no need to open the file
+    if (ramResident)
+    {
+        DecodedTrackCache::TrackPtr decoded = decodedTracks.find(audioURL);
+        if (decoded != nullptr)
+        {
+            return new DeckTrack(decoded);
+        }
+    }
+
+    //once decoded to the PCM cache, reading the mapped file costs no decoding at all
+    std::unique_ptr<AudioFormatReader> reader(pcmCache.createMappedReader(audioURL));
+    if (reader != nullptr)
+    {
+        pcmCache.markUsed(audioURL);
+    }
+    else
+    {
+        reader.reset(formatManager.createReaderFor(audioURL.createInputStream(false)));
+        if (reader != nullptr)
+        {
+            //decoded as 32-bit float, at most stereo
+            pcmCache.cacheInBackground(audioURL, reader->lengthInSamples * jlimit(1, 2, (int)reader->numChannels) * 4);
+        }
+    }
+
+    if (reader == nullptr || reader->sampleRate <= 0) // bad file!
+    {
+        return nullptr;
+    }
+
+    if (ramResident)
+    {
+        DecodedTrackCache::TrackPtr decoded = decodedTracks.getOrDecode(audioURL, *reader);
+        if (decoded != nullptr)
+        {
+            return new DeckTrack(decoded);
+        }
+        //too big for the memory budget, stream it instead
+    }
+
+    return new DeckTrack(reader.release(), diskThread, readAheadSamples, underrunCounter);
+}
+
+void DeckTrackLoader::handleAsyncUpdate()
+{
+    for (int slot = 0; slot < 2; ++slot)
+    {
+        std::unique_ptr<DeckTrack> track;
+        URL audioURL;
+        {
+            const ScopedLock sl(resultLock);
+            if (!results[slot].ready)
+            {
+                continue;
+            }
+            track = std::move(results[slot].track);
+            audioURL = results[slot].audioURL;
+            results[slot].ready = false;
+        }
+
+        if (onTrackLoaded != nullptr)
+        {
+            onTrackLoaded(track.release(), audioURL, slot == 1);
+        }
+    }
+}
+
+void DeckTrackLoader::deleteRetiredTracks()
+{
+    int start1, size1, start2, size2;
+    retiredFifo.prepareToRead(retiredFifo.getNumReady(), start1, size1, start2, size2);
+
+    for (int i = 0; i < size1; ++i)
+    {
+        delete retiredTracks[start1 + i];
+    }
+    for (int i = 0; i < size2; ++i)
+    {
+        delete retiredTracks[start2 + i];
+    }
+
+    retiredFifo.finishedRead(size1 + size2);
+}
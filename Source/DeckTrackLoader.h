@@ -0,0 +1,107 @@
+/*
+  ==============================================================================
+    DeckTrackLoader.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "DeckTrack.h"
+#include "DecodedTrackCache.h"
+#include "PcmFileCache.h"
+#include <atomic>
+#include <functional>
+
+//===============================================================================
+/*
+    Opens and prepares tracks for a deck on a background thread, so loading a file never
+    blocks the message thread or the audio callback. Finished tracks are handed back on the
+    message thread. Tracks the deck has finished with are retired to this thread to be deleted,
+    so the audio thread never frees memory.
+*/
+class DeckTrackLoader : private Thread,
+    private AsyncUpdater
+{
+public:
+
+    /**Streamed tracks are read ahead by the shared disk thread, and report buffer underruns to the counter.
+    RAM-resident tracks are decoded into, or taken from, the shared cache.
+    Tracks already decoded to the PCM file cache are read from the mapped file instead of the original*/
+    DeckTrackLoader(AudioFormatManager& formatManager,
+        TimeSliceThread& diskThread,
+        DecodedTrackCache& decodedTracks,
+        PcmFileCache& pcmCache,
+        std::atomic<int>& underrunCounter);
+    ~DeckTrackLoader();
+
+    //==============================================================================
+    /**Called on the message thread when a load has finished. Ownership of the track passes
+    to the callback. The track is nullptr if the file could not be opened*/
+    std::function<void(DeckTrack* track, const URL& audioURL, bool asNextTrack)> onTrackLoaded;
+
+    /**Open the file in the background and prepare it for the given device settings,
+    filling a read-ahead buffer of the given number of samples.
+    If ramResident is true the whole track is decoded into memory instead, falling back to
+    streaming if it does not fit in the cache's budget.
+    A load requested while another is still running replaces it. Loads of the deck's next track
+    are kept apart from loads of the track to play, so one never replaces the other*/
+    void load(const URL& audioURL, int samplesPerBlockExpected, double sampleRate, int readAheadSamples, bool ramResident,
+        bool asNextTrack = false);
+
+    /**Hand a track over to be deleted in the background, called from the audio thread.
+    Returns false if the queue is full, in which case the caller keeps the track and tries again later*/
+    bool retireTrack(DeckTrack* track);
+
+private:
+    //==============================================================================
+    /**Override of Thread pure virtual. Opens requested files and deletes retired tracks*/
+    void run() override;
+    /**Override of AsyncUpdater pure virtual. Delivers the loaded track on the message thread*/
+    void handleAsyncUpdate() override;
+
+    /**Delete every track waiting in the retired queue*/
+    void deleteRetiredTracks();
+    /**Open the track for the request, on the loader thread. Returns nullptr if it could not be opened*/
+    DeckTrack* openTrack(const URL& audioURL, int readAheadSamples, bool ramResident);
+
+    AudioFormatManager& formatManager;
+    TimeSliceThread& diskThread;
+    DecodedTrackCache& decodedTracks;
+    PcmFileCache& pcmCache;
+    std::atomic<int>& underrunCounter;
+
+    /**A load requested by the message thread*/
+    struct Request
+    {
+        bool pending = false;
+        URL audioURL;
+        int blockSize = 0;
+        double sampleRate = 0.0;
+        int readAhead = 0;
+        bool ramResident = false;
+    };
+
+    /**A finished load, waiting to be delivered to the message thread*/
+    struct Result
+    {
+        bool ready = false;
+        std::unique_ptr<DeckTrack> track;
+        URL audioURL;
+    };
+
+    //latest loads requested, of the track to play and of the next track
+    CriticalSection requestLock;
+    Request requests[2];
+
+    CriticalSection resultLock;
+    Result results[2];
+
+    //tracks retired by the audio thread
+    enum { retiredCapacity = 16 };
+    AbstractFifo retiredFifo{ retiredCapacity };
+    DeckTrack* retiredTracks[retiredCapacity];
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeckTrackLoader)
+};
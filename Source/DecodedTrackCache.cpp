@@ -0,0 +1,155 @@
+/*
+  ==============================================================================
+    DecodedTrackCache.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "DecodedTrackCache.h"
+
+DecodedTrackCache::DecodedTrackCache(int64 memoryBudgetBytes)
+    : memoryBudget(memoryBudgetBytes)
+{}
+
+DecodedTrackCache::~DecodedTrackCache()
+{}
+
+//==============================================================================
+void DecodedTrackCache::setMemoryBudget(int64 numBytes)
+{
+    const ScopedLock sl(lock);
+    memoryBudget = numBytes;
+    makeRoom(0);
+}
+
+int64 DecodedTrackCache::getMemoryBudget() const
+{
+    const ScopedLock sl(lock);
+    return memoryBudget;
+}
+
+int64 DecodedTrackCache::getMemoryUsed() const
+{
+    const ScopedLock sl(lock);
+    return memoryUsed + memoryReserved;
+}
+
+
+//==============================================================================
+DecodedTrackCache::TrackPtr DecodedTrackCache::find(const URL& audioURL)
+{
+    const String key = getKey(audioURL);
+
+    const ScopedLock sl(lock);
+    for (Entry& entry : entries)
+    {
+        if (entry.key == key)
+        {
+            entry.lastUsed = ++useCounter;
+            return entry.track;
+        }
+    }
+    return nullptr;
+}
+
+DecodedTrackCache::TrackPtr DecodedTrackCache::getOrDecode(const URL& audioURL, AudioFormatReader& reader)
+{
+    TrackPtr cached = find(audioURL);
+    if (cached != nullptr)
+    {
+        return cached;
+    }
+
+    //decks play stereo, so mono files are stored once and copied to both channels on playback
+    const int numChannels = jlimit(1, 2, (int)reader.numChannels);
+    const int64 numSamples = reader.lengthInSamples;
+    const int64 numBytes = numSamples * numChannels * (int64)sizeof(float);
+
+    if (numSamples <= 0 || numSamples > std::numeric_limits<int>::max())
+    {
+        return nullptr;
+    }
+
+    //set the memory aside before decoding, so decks loading at the same time cannot exceed the budget
+    {
+        const ScopedLock sl(lock);
+        if (!makeRoom(numBytes))
+        {
+            return nullptr;
+        }
+        memoryReserved += numBytes;
+    }
+
+    std::shared_ptr<DecodedTrack> decoded(new DecodedTrack());
+    decoded->sampleRate = reader.sampleRate;
+    decoded->audio.setSize(numChannels, (int)numSamples);
+    const bool readOk = reader.read(&decoded->audio, 0, (int)numSamples, 0, true, numChannels > 1);
+
+    const ScopedLock sl(lock);
+    memoryReserved -= numBytes;
+
+    if (!readOk)
+    {
+        return nullptr;
+    }
+
+    //another deck may have decoded the same track meanwhile
+    const String key = getKey(audioURL);
+    for (Entry& entry : entries)
+    {
+        if (entry.key == key)
+        {
+            entry.lastUsed = ++useCounter;
+            return entry.track;
+        }
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.track = decoded;
+    entry.numBytes = numBytes;
+    entry.lastUsed = ++useCounter;
+    entries.push_back(entry);
+    memoryUsed += numBytes;
+
+    return decoded;
+}
+
+
+//==============================================================================
+String DecodedTrackCache::getKey(const URL& audioURL)
+{
+    if (audioURL.isLocalFile())
+    {
+        File file = audioURL.getLocalFile();
+        return file.getFullPathName() + ":" + String(file.getLastModificationTime().toMilliseconds());
+    }
+    return audioURL.toString(false);
+}
+
+bool DecodedTrackCache::makeRoom(int64 numBytes)
+{
+    while (memoryUsed + memoryReserved + numBytes > memoryBudget)
+    {
+        //least recently used track not held by any deck
+        int oldest = -1;
+        for (int i = 0; i < (int)entries.size(); ++i)
+        {
+            if (entries[i].track.use_count() == 1
+                && (oldest < 0 || entries[i].lastUsed < entries[oldest].lastUsed))
+            {
+                oldest = i;
+            }
+        }
+
+        //everything left is being played
+        if (oldest < 0)
+        {
+            return false;
+        }
+
+        memoryUsed -= entries[oldest].numBytes;
+        entries.erase(entries.begin() + oldest);
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+/*
+  ==============================================================================
+    DecodedTrackCache.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <limits>
+#include <memory>
+#include <vector>
+
+//===============================================================================
+/*
+    Fully decoded tracks kept in memory for decks playing in RAM-resident mode, shared by all decks.
+    The total size is kept within a memory budget by evicting the least recently used
+    tracks that no deck is playing, so reloading a recent track does not decode it again.
+*/
+class DecodedTrackCache
+{
+public:
+
+    //==============================================================================
+    /**The whole of a track as 32-bit float samples, at the file's own sample rate*/
+    struct DecodedTrack
+    {
+        AudioBuffer<float> audio;
+        double sampleRate = 0.0;
+    };
+    typedef std::shared_ptr<const DecodedTrack> TrackPtr;
+
+    //==============================================================================
+    DecodedTrackCache(int64 memoryBudgetBytes);
+    ~DecodedTrackCache();
+
+    /**Set the maximum number of bytes of decoded audio to keep, evicting tracks if needed*/
+    void setMemoryBudget(int64 numBytes);
+    int64 getMemoryBudget() const;
+    /**Number of bytes held by cached tracks, including tracks currently being decoded*/
+    int64 getMemoryUsed() const;
+
+    //==============================================================================
+    /**Returns the decoded track for the file, decoding it with the reader if it is not cached.
+    Can be called from any thread; the decoding happens on the calling thread without holding a lock.
+    Returns nullptr if the track does not fit in the budget, or could not be read*/
+    TrackPtr getOrDecode(const URL& audioURL, AudioFormatReader& reader);
+
+    /**Returns the decoded track if it is cached, without decoding*/
+    TrackPtr find(const URL& audioURL);
+
+private:
+
+    struct Entry
+    {
+        String key;
+        TrackPtr track;
+        int64 numBytes;
+        uint32 lastUsed;
+    };
+
+    /**Identifies the file, including its modification time so edited files are decoded again*/
+    static String getKey(const URL& audioURL);
+    /**Evict unused tracks, least recently used first, until numBytes more fit in the budget.
+    Must be called with the lock held*/
+    bool makeRoom(int64 numBytes);
+
+    CriticalSection lock;
+    std::vector<Entry> entries;
+    int64 memoryBudget;
+    int64 memoryUsed = 0;
+    //bytes set aside for tracks being decoded
+    int64 memoryReserved = 0;
+    uint32 useCounter = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DecodedTrackCache)
+};
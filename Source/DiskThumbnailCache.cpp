@@ -0,0 +1,214 @@
+/*
+  ==============================================================================
+    DiskThumbnailCache.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "DiskThumbnailCache.h"
+
+//==============================================================================
+class DiskThumbnailCache::GenerateJob : public ThreadPoolJob
+{
+public:
+    GenerateJob(DiskThumbnailCache& _owner, const URL& _audioURL, int64 _hashCode)
+        : ThreadPoolJob("DiskThumbnailCache::GenerateJob"),
+          owner(_owner),
+          audioURL(_audioURL),
+          hashCode(_hashCode)
+    {}
+
+    JobStatus runJob() override
+    {
+        owner.generate(audioURL, hashCode, *this);
+        return jobHasFinished;
+    }
+
+private:
+    DiskThumbnailCache& owner;
+    URL audioURL;
+    int64 hashCode;
+};
+
+//==============================================================================
+class DiskThumbnailCache::RemoveJob : public ThreadPoolJob
+{
+public:
+    RemoveJob(DiskThumbnailCache& _owner, std::unordered_set<int64> _hashesToKeep)
+        : ThreadPoolJob("DiskThumbnailCache::RemoveJob"),
+          owner(_owner),
+          hashesToKeep(std::move(_hashesToKeep))
+    {}
+
+    JobStatus runJob() override
+    {
+        owner.removeExcept(hashesToKeep);
+        return jobHasFinished;
+    }
+
+private:
+    DiskThumbnailCache& owner;
+    std::unordered_set<int64> hashesToKeep;
+};
+
+
+//==============================================================================
+DiskThumbnailCache::DiskThumbnailCache(int maxThumbsInMemory,
+    const File& _cacheDirectory,
+    AudioFormatManager& _formatManager,
+    PcmFileCache& _pcmCache)
+    : AudioThumbnailCache(maxThumbsInMemory),
+      cacheDirectory(_cacheDirectory),
+      formatManager(_formatManager),
+      pcmCache(_pcmCache)
+{
+    cacheDirectory.createDirectory();
+    pool.setThreadPriorities(3);
+
+    //the only scan of the directory, files are named after the hash of their track
+    for (const File& f : cacheDirectory.findChildFiles(File::findFiles, false, "*.thumb"))
+    {
+        thumbnailsOnDisk.insert(f.getFileNameWithoutExtension().getHexValue64());
+    }
+}
+
+DiskThumbnailCache::~DiskThumbnailCache()
+{
+    pool.removeAllJobs(true, 10000);
+}
+
+
+//==============================================================================
+void DiskThumbnailCache::generateInBackground(const URL& audioURL, int64 hashCode)
+{
+    //most tracks already have one from an earlier session, and are not queued at all
+    if (!hasThumbnailOnDisk(hashCode))
+    {
+        pool.addJob(new GenerateJob(*this, audioURL, hashCode), true);
+    }
+}
+
+bool DiskThumbnailCache::hasThumbnailOnDisk(int64 hashCode) const
+{
+    const ScopedLock sl(thumbnailsOnDiskLock);
+    return thumbnailsOnDisk.count(hashCode) > 0;
+}
+
+void DiskThumbnailCache::removeThumbnailsExcept(std::unordered_set<int64> hashesToKeep)
+{
+    pool.addJob(new RemoveJob(*this, std::move(hashesToKeep)), true);
+}
+
+void DiskThumbnailCache::generate(const URL& audioURL, int64 hashCode, ThreadPoolJob& job)
+{
+    //queued twice, or finished by a deck's waveform in the meantime
+    if (hasThumbnailOnDisk(hashCode))
+    {
+        return;
+    }
+
+    std::unique_ptr<AudioFormatReader> reader(pcmCache.createMappedReader(audioURL));
+    if (reader == nullptr)
+    {
+        reader.reset(formatManager.createReaderFor(audioURL.createInputStream(false)));
+    }
+    if (reader == nullptr || reader->lengthInSamples <= 0)
+    {
+        return;
+    }
+
+    //fill the thumbnail directly from the reader, rather than through the cache's own thread
+    AudioThumbnail thumb(samplesPerThumbnail, formatManager, *this);
+    const int numChannels = jlimit(1, 2, (int)reader->numChannels);
+    thumb.reset(numChannels, reader->sampleRate, reader->lengthInSamples);
+
+    //a multiple of the thumbnail resolution, so each block fills whole thumbnail samples
+    const int blockSize = samplesPerThumbnail * 64;
+    AudioBuffer<float> buffer(numChannels, blockSize);
+
+    for (int64 pos = 0; pos < reader->lengthInSamples; pos += blockSize)
+    {
+        if (job.shouldExit())
+        {
+            return;
+        }
+
+        const int numSamples = (int)jmin((int64)blockSize, reader->lengthInSamples - pos);
+        if (!reader->read(&buffer, 0, numSamples, pos, true, numChannels > 1))
+        {
+            return;
+        }
+        thumb.addBlock(pos, buffer, 0, numSamples);
+    }
+
+    //keeps it in memory and writes it to disk through saveNewlyFinishedThumbnail
+    storeThumb(thumb, hashCode);
+}
+
+
+//==============================================================================
+void DiskThumbnailCache::saveNewlyFinishedThumbnail(const AudioThumbnailBase& thumb, int64 hashCode)
+{
+    //write to a temporary file first, so a half written thumbnail is never loaded
+    TemporaryFile temp(getThumbnailFile(hashCode));
+    {
+        std::unique_ptr<FileOutputStream> out(temp.getFile().createOutputStream());
+        if (out == nullptr)
+        {
+            return;
+        }
+        thumb.saveTo(*out);
+        out->flush();
+        if (out->getStatus().failed())
+        {
+            return;
+        }
+    }
+    if (temp.overwriteTargetFileWithTemporary())
+    {
+        const ScopedLock sl(thumbnailsOnDiskLock);
+        thumbnailsOnDisk.insert(hashCode);
+    }
+}
+
+void DiskThumbnailCache::removeExcept(const std::unordered_set<int64>& hashesToKeep)
+{
+    std::vector<int64> unused;
+    {
+        const ScopedLock sl(thumbnailsOnDiskLock);
+        for (int64 hashCode : thumbnailsOnDisk)
+        {
+            if (hashesToKeep.count(hashCode) == 0)
+            {
+                unused.push_back(hashCode);
+            }
+        }
+    }
+
+    //deleted outside the lock, a deck reading one as it goes simply finds it missing and makes a new one
+    for (int64 hashCode : unused)
+    {
+        if (getThumbnailFile(hashCode).deleteFile())
+        {
+            const ScopedLock sl(thumbnailsOnDiskLock);
+            thumbnailsOnDisk.erase(hashCode);
+        }
+    }
+}
+
+bool DiskThumbnailCache::loadNewThumb(AudioThumbnailBase& thumb, int64 hashCode)
+{
+    File thumbnailFile = getThumbnailFile(hashCode);
+    if (!thumbnailFile.existsAsFile())
+    {
+        return false;
+    }
+
+    std::unique_ptr<FileInputStream> in(thumbnailFile.createInputStream());
+    return in != nullptr && thumb.loadFrom(*in);
+}
+
+File DiskThumbnailCache::getThumbnailFile(int64 hashCode) const
+{
+    return cacheDirectory.getChildFile(String::toHexString(hashCode) + ".thumb");
+}
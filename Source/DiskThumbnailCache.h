@@ -0,0 +1,76 @@
+/*
+  ==============================================================================
+    DiskThumbnailCache.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PcmFileCache.h"
+#include <unordered_set>
+
+//===============================================================================
+/*
+    AudioThumbnailCache that also keeps every finished thumbnail in a file on disk, named after
+    the track's hash, so waveforms are restored instantly on later loads and launches.
+    Thumbnails for tracks imported to the library can be generated in the background,
+    before the track is ever loaded to a deck. The thumbnails on disk are listed once at startup,
+    so finding out whether a track needs one never touches the disk.
+*/
+class DiskThumbnailCache : public AudioThumbnailCache
+{
+public:
+
+    /**Source samples per thumbnail sample. Thumbnails drawn from this cache must use the same resolution*/
+    enum { samplesPerThumbnail = 1000 };
+
+    DiskThumbnailCache(int maxThumbsInMemory,
+        const File& cacheDirectory,
+        AudioFormatManager& formatManager,
+        PcmFileCache& pcmCache);
+    ~DiskThumbnailCache() override;
+
+    //==============================================================================
+    /**Generate and store the thumbnail for the track on a background thread, unless it is already on disk.
+    The hash is the track's from PcmFileCache::getTrackHash, which changes whenever the file does,
+    so a thumbnail found under it is never older than the file*/
+    void generateInBackground(const URL& audioURL, int64 hashCode);
+    /**True if a thumbnail for the track with this hash is stored on disk*/
+    bool hasThumbnailOnDisk(int64 hashCode) const;
+    /**Delete the thumbnails on disk of every track not in the set, on the background thread,
+    for tracks that have left the library or changed since their thumbnail was made*/
+    void removeThumbnailsExcept(std::unordered_set<int64> hashesToKeep);
+
+protected:
+    //==============================================================================
+    /**Override of AudioThumbnailCache. Writes the finished thumbnail to its file*/
+    void saveNewlyFinishedThumbnail(const AudioThumbnailBase& thumb, int64 hashCode) override;
+    /**Override of AudioThumbnailCache. Reads the thumbnail from its file if it exists*/
+    bool loadNewThumb(AudioThumbnailBase& thumb, int64 hashCode) override;
+
+private:
+    //==============================================================================
+    class GenerateJob;
+    class RemoveJob;
+
+    File getThumbnailFile(int64 hashCode) const;
+    /**Read the whole track and store its thumbnail, on a pool thread*/
+    void generate(const URL& audioURL, int64 hashCode, ThreadPoolJob& job);
+    /**Delete the thumbnail files not in the set, on a pool thread*/
+    void removeExcept(const std::unordered_set<int64>& hashesToKeep);
+
+    File cacheDirectory;
+    AudioFormatManager& formatManager;
+    PcmFileCache& pcmCache;
+
+    //hashes of the thumbnails stored on disk, listed in the constructor and kept up to date after
+    CriticalSection thumbnailsOnDiskLock;
+    std::unordered_set<int64> thumbnailsOnDisk;
+
+    //one low priority thread, so importing does not slow down playback or the GUI
+    ThreadPool pool{ 1 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DiskThumbnailCache)
+};
@@ -0,0 +1,45 @@
+/*
+  ==============================================================================
+    DisplayScheduler.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "DisplayScheduler.h"
+
+DisplayScheduler::DisplayScheduler()
+{
+    startTimerHz(frameRate);
+}
+
+DisplayScheduler::~DisplayScheduler()
+{
+    stopTimer();
+}
+
+//==============================================================================
+void DisplayScheduler::addClient(Client* client)
+{
+    clients.add(client);
+}
+
+void DisplayScheduler::removeClient(Client* client)
+{
+    clients.remove(client);
+}
+
+void DisplayScheduler::setFrameRate(int framesPerSecond)
+{
+    frameRate = jlimit(10, 240, framesPerSecond);
+    startTimerHz(frameRate);
+}
+
+int DisplayScheduler::getFrameRate() const
+{
+    return frameRate;
+}
+
+void DisplayScheduler::timerCallback()
+{
+    clients.call([](Client& c) { c.displayRefresh(); });
+}
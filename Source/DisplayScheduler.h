@@ -0,0 +1,52 @@
+/*
+  ==============================================================================
+    DisplayScheduler.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//===============================================================================
+/*
+    One timer shared by everything on screen that follows the audio: playheads, level meters
+    and the up next lists. It runs at the display's refresh rate, so every client updates in the
+    same frame rather than each drifting on its own Timer.
+*/
+class DisplayScheduler : private Timer
+{
+public:
+
+    //==============================================================================
+    /**Updated once per frame, on the message thread*/
+    class Client
+    {
+    public:
+        virtual ~Client() {}
+        /**Called once per frame. Clients should only repaint what has changed*/
+        virtual void displayRefresh() = 0;
+    };
+
+    /**Runs at 60 frames per second unless told the display's rate*/
+    DisplayScheduler();
+    ~DisplayScheduler();
+
+    void addClient(Client* client);
+    void removeClient(Client* client);
+
+    /**Set the number of frames per second, normally the refresh rate of the display*/
+    void setFrameRate(int framesPerSecond);
+    int getFrameRate() const;
+
+private:
+    //==============================================================================
+    /**Override of Timer pure virtual. Refreshes every client*/
+    void timerCallback() override;
+
+    ListenerList<Client> clients;
+    int frameRate = 60;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DisplayScheduler)
+};
@@ -0,0 +1,193 @@
+/*
+  ==============================================================================
+    KeyDetector.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "KeyDetector.h"
+#include <cmath>
+
+namespace
+{
+    //rate the audio is decimated to, the key's notes are all well below its Nyquist frequency
+    const double targetRate = 11025.0;
+
+    //range of notes counted, the bass below is too coarse for the FFT and the top is mostly overtones
+    const double lowestFrequency = 100.0;
+    const double highestFrequency = 2000.0;
+
+    //Krumhansl-Kessler profiles, how strongly each degree of the scale suggests the key
+    const float majorProfile[12] = { 6.35f, 2.23f, 3.48f, 2.33f, 4.38f, 4.09f, 2.52f, 5.19f, 2.39f, 3.66f, 2.29f, 2.88f };
+    const float minorProfile[12] = { 6.33f, 2.68f, 3.52f, 5.38f, 2.60f, 3.53f, 2.54f, 4.75f, 3.98f, 2.69f, 3.34f, 3.17f };
+
+    const char* const majorNames[12] = { "C", "Db", "D", "Eb", "E", "F", "F#", "G", "Ab", "A", "Bb", "B" };
+    const char* const minorNames[12] = { "Cm", "C#m", "Dm", "Ebm", "Em", "Fm", "F#m", "Gm", "G#m", "Am", "Bbm", "Bm" };
+
+    /**Correlation of the chromagram, starting from the tonic, with a key profile*/
+    double correlate(const double* chroma, int tonic, const float* profile)
+    {
+        double chromaMean = 0.0;
+        double profileMean = 0.0;
+        for (int i = 0; i < 12; ++i)
+        {
+            chromaMean += chroma[i];
+            profileMean += profile[i];
+        }
+        chromaMean /= 12.0;
+        profileMean /= 12.0;
+
+        double product = 0.0;
+        double chromaSquares = 0.0;
+        double profileSquares = 0.0;
+        for (int i = 0; i < 12; ++i)
+        {
+            const double c = chroma[(tonic + i) % 12] - chromaMean;
+            const double p = profile[i] - profileMean;
+            product += c * p;
+            chromaSquares += c * c;
+            profileSquares += p * p;
+        }
+        return chromaSquares > 0.0 ? product / std::sqrt(chromaSquares * profileSquares) : 0.0;
+    }
+
+    /**Pitch class of the relative major of a key in Camelot order, 0 for C*/
+    int getRelativeMajor(int key)
+    {
+        //each step around the wheel is a fifth, and 8B is C major
+        return (7 * (key / 2 - 7) % 12 + 12) % 12;
+    }
+}
+
+KeyDetector::KeyDetector(double sampleRate)
+    : decimationFactor(jmax(1, (int)(sampleRate / targetRate))),
+      decimatedRate(sampleRate / decimationFactor),
+      //about a third of a second per frame, fine enough to tell apart the semitones of the lowest notes
+      fft(12),
+      fftSize(1 << 12)
+{
+    for (IIRFilter& filter : antiAliasFilters)
+    {
+        filter.setCoefficients(IIRCoefficients::makeLowPass(sampleRate, decimatedRate * 0.4));
+    }
+
+    window.allocate((size_t)fftSize, false);
+    for (int i = 0; i < fftSize; ++i)
+    {
+        window[i] = 0.5f - 0.5f * std::cos(MathConstants<float>::twoPi * i / fftSize);
+    }
+    fftData.allocate((size_t)fftSize * 2, true);
+    frameInput.allocate((size_t)fftSize, true);
+
+    lowestBin = (int)std::ceil(lowestFrequency * fftSize / decimatedRate);
+    highestBin = jmin(fftSize / 2, (int)(highestFrequency * fftSize / decimatedRate));
+    spectrumSum.allocate((size_t)(highestBin - lowestBin + 1), true);
+}
+
+KeyDetector::~KeyDetector()
+{}
+
+//==============================================================================
+void KeyDetector::process(const float* samples, int numSamples)
+{
+    if ((int)filtered.size() < numSamples)
+    {
+        filtered.resize((size_t)numSamples);
+    }
+    FloatVectorOperations::copy(filtered.data(), samples, numSamples);
+    for (IIRFilter& filter : antiAliasFilters)
+    {
+        filter.processSamples(filtered.data(), numSamples);
+    }
+
+    int i = decimationPhase;
+    for (; i < numSamples; i += decimationFactor)
+    {
+        frameInput[frameFill++] = filtered[(size_t)i];
+        if (frameFill == fftSize)
+        {
+            analyseFrame();
+            frameFill = 0;
+        }
+    }
+    decimationPhase = i - numSamples;
+}
+
+bool KeyDetector::finish()
+{
+    if (numFrames == 0)
+    {
+        return false;
+    }
+
+    //fold the spectrum into pitch classes, each bin going to its nearest note
+    double chroma[12] = {};
+    for (int bin = lowestBin; bin <= highestBin; ++bin)
+    {
+        const double frequency = bin * decimatedRate / fftSize;
+        const int note = roundToInt(69.0 + 12.0 * std::log2(frequency / 440.0));
+        chroma[note % 12] += spectrumSum[bin - lowestBin];
+    }
+
+    double bestCorrelation = 0.0;
+    for (int tonic = 0; tonic < 12; ++tonic)
+    {
+        const double majorCorrelation = correlate(chroma, tonic, majorProfile);
+        const double minorCorrelation = correlate(chroma, tonic, minorProfile);
+
+        //Camelot number counts fifths from B major and its relative minor
+        if (majorCorrelation > bestCorrelation)
+        {
+            bestCorrelation = majorCorrelation;
+            key = (tonic * 7 + 7) % 12 * 2 + 1;
+        }
+        if (minorCorrelation > bestCorrelation)
+        {
+            bestCorrelation = minorCorrelation;
+            key = ((tonic + 3) % 12 * 7 + 7) % 12 * 2;
+        }
+    }
+    return key >= 0;
+}
+
+int KeyDetector::getKey() const
+{
+    return key;
+}
+
+//==============================================================================
+String KeyDetector::getCamelotCode(int key)
+{
+    if (key < 0)
+    {
+        return {};
+    }
+    return String(key / 2 + 1) + (key % 2 == 1 ? "B" : "A");
+}
+
+String KeyDetector::getKeyName(int key)
+{
+    if (key < 0)
+    {
+        return {};
+    }
+    const int relativeMajor = getRelativeMajor(key);
+    return key % 2 == 1 ? majorNames[relativeMajor] : minorNames[(relativeMajor + 9) % 12];
+}
+
+//==============================================================================
+void KeyDetector::analyseFrame()
+{
+    FloatVectorOperations::multiply(fftData.get(), frameInput.get(), window.get(), fftSize);
+    FloatVectorOperations::clear(fftData + fftSize, fftSize);
+    fft.performFrequencyOnlyForwardTransform(fftData);
+
+    //every frame counts the same however loud it is, silent frames are left out
+    const int numBins = highestBin - lowestBin + 1;
+    const float loudest = FloatVectorOperations::findMaximum(fftData + lowestBin, numBins);
+    if (loudest > 1.0e-3f)
+    {
+        FloatVectorOperations::addWithMultiply(spectrumSum.get(), fftData + lowestBin, 1.0f / loudest, numBins);
+        ++numFrames;
+    }
+}
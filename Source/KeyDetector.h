@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+    KeyDetector.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+//===============================================================================
+/*
+    Finds the musical key of a track from its audio, fed a chunk at a time.
+    The audio is low-passed and decimated to about 11 kHz, which keeps every note that
+    matters for the key while cutting the cost of the FFTs by the decimation factor. The
+    normalised spectrum of each frame is summed over the track, folded into a chromagram of
+    the twelve pitch classes, and compared with the major and minor key profiles in all
+    twelve transpositions.
+    Keys are numbered in the order of the Camelot wheel, 1A, 1B, 2A ... 12B, so that keys which
+    mix well sort next to each other.
+*/
+class KeyDetector
+{
+public:
+
+    KeyDetector(double sampleRate);
+    ~KeyDetector();
+
+    //==============================================================================
+    /**Feed the next mono samples of the track*/
+    void process(const float* samples, int numSamples);
+
+    /**Work out the key from everything processed so far.
+    Returns false if the track had no tonal content to go on*/
+    bool finish();
+
+    /**Key from 0 to 23 in Camelot order, once finish has succeeded*/
+    int getKey() const;
+
+    //==============================================================================
+    /**Camelot code of a key, such as "8A", or an empty string for -1*/
+    static String getCamelotCode(int key);
+    /**Name of a key, such as "Am" or "F#", or an empty string for -1*/
+    static String getKeyName(int key);
+
+private:
+    //==============================================================================
+    /**Add the spectrum of the frame waiting in the input buffer to the total*/
+    void analyseFrame();
+
+    int decimationFactor;
+    double decimatedRate;
+
+    //two low-pass sections in series, against aliasing when decimating
+    IIRFilter antiAliasFilters[2];
+    std::vector<float> filtered;
+    //position in the decimation of the first sample of the next chunk
+    int decimationPhase = 0;
+
+    dsp::FFT fft;
+    int fftSize;
+    HeapBlock<float> window;
+    HeapBlock<float> fftData;
+
+    HeapBlock<float> frameInput;
+    int frameFill = 0;
+
+    //bins of the range of notes used, and the sum of their normalised magnitudes over the track
+    int lowestBin;
+    int highestBin;
+    HeapBlock<float> spectrumSum;
+    int numFrames = 0;
+
+    int key = -1;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(KeyDetector)
+};
@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+    LevelMeter.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "LevelMeter.h"
+
+namespace
+{
+    //range of the meter in decibels below full scale
+    const float meterRangeDb = 60.0f;
+}
+
+LevelMeter::LevelMeter()
+{
+    setOpaque(true);
+    setInterceptsMouseClicks(false, false);
+}
+
+LevelMeter::~LevelMeter()
+{}
+
+//==============================================================================
+void LevelMeter::paint(Graphics& g)
+{
+    g.fillAll(juce::Colours::black);
+
+    //green, turning orange then red towards full scale
+    const int barHeight = getBarHeight();
+    Rectangle<int> bar = getLocalBounds().removeFromBottom(barHeight);
+    ColourGradient gradient(juce::Colours::mediumspringgreen, 0.0f, (float)getHeight(),
+        juce::Colours::red, 0.0f, 0.0f, false);
+    gradient.addColour(0.8, juce::Colours::orange);
+    g.setGradientFill(gradient);
+    g.fillRect(bar);
+}
+
+void LevelMeter::setLevel(float peak)
+{
+    const int oldHeight = getBarHeight();
+
+    //rise immediately, fall back gradually
+    displayedLevel = jmax(peak, displayedLevel * 0.9f);
+    if (displayedLevel < 0.0001f)
+    {
+        displayedLevel = 0.0f;
+    }
+
+    if (getBarHeight() != oldHeight)
+    {
+        repaint();
+    }
+}
+
+int LevelMeter::getBarHeight() const
+{
+    const float db = Decibels::gainToDecibels(displayedLevel, -meterRangeDb);
+    return roundToInt(getHeight() * (db + meterRangeDb) / meterRangeDb);
+}
@@ -0,0 +1,39 @@
+/*
+  ==============================================================================
+    LevelMeter.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//===============================================================================
+/*
+    Vertical peak meter for a deck's output, on a decibel scale. The level falls back
+    gradually after a peak, and the meter only repaints when the bar changes height.
+*/
+class LevelMeter : public Component
+{
+public:
+
+    LevelMeter();
+    ~LevelMeter() override;
+
+    //==============================================================================
+    /**Customise input graphics*/
+    void paint(Graphics& g) override;
+
+    /**Show the peak level since the last frame, as a gain where 1 is full scale. Called once per frame*/
+    void setLevel(float peak);
+
+private:
+    //==============================================================================
+    /**Height of the bar in pixels for the displayed level*/
+    int getBarHeight() const;
+
+    float displayedLevel = 0.0f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LevelMeter)
+};
@@ -0,0 +1,193 @@
+/*
+  ==============================================================================
+
+    LibraryDatabase.cpp
+    Author:  Shamie
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "LibraryDatabase.h"
+
+namespace
+{
+    //identifies the file, and the layout of the entries that follow
+    const int databaseMagic = (int)ByteOrder::littleEndianInt("OTOL");
+    //version 2 added the date each track was added to the library and whether it has been analysed
+    const int databaseVersion = 2;
+}
+
+//==============================================================================
+bool LibraryDatabase::Entry::matchesFile(const File& file) const
+{
+    return file.existsAsFile()
+        && file.getLastModificationTime().toMilliseconds() == modificationTime
+        && file.getSize() == fileSize;
+}
+
+
+//==============================================================================
+LibraryDatabase::LibraryDatabase()
+    : LibraryDatabase(File::getSpecialLocation(File::userApplicationDataDirectory)
+                        .getChildFile("OtoDecks")
+                        .getChildFile("library.db"))
+{}
+
+LibraryDatabase::LibraryDatabase(const File& _databaseFile)
+    : databaseFile(_databaseFile)
+{}
+
+LibraryDatabase::~LibraryDatabase()
+{
+    save();
+}
+
+
+//==============================================================================
+bool LibraryDatabase::load()
+{
+    entries.clear();
+    pathIndex.clear();
+    dirty = false;
+
+    //map the file rather than reading it, the whole index is parsed in one pass
+    MemoryMappedFile mappedFile(databaseFile, MemoryMappedFile::readOnly);
+    if (mappedFile.getData() == nullptr)
+    {
+        return false;
+    }
+
+    MemoryInputStream in(mappedFile.getData(), mappedFile.getSize(), false);
+    if (in.readInt() != databaseMagic)
+    {
+        return false;
+    }
+    const int version = in.readInt();
+    if (version < 1 || version > databaseVersion)
+    {
+        return false;
+    }
+
+    const int numEntries = in.readInt();
+    if (numEntries < 0)
+    {
+        return false;
+    }
+    entries.reserve(numEntries);
+
+    for (int i = 0; i < numEntries && !in.isExhausted(); ++i)
+    {
+        Entry entry;
+        entry.path = in.readString();
+        entry.modificationTime = in.readInt64();
+        entry.fileSize = in.readInt64();
+        if (version >= 2)
+        {
+            entry.dateAdded = in.readInt64();
+        }
+        else
+        {
+            //not recorded, the file's modification time when it was last scanned is the closest there is
+            entry.dateAdded = entry.modificationTime;
+        }
+        entry.lengthInSeconds = in.readDouble();
+        entry.sampleRate = in.readDouble();
+        entry.numChannels = in.readInt();
+        entry.bpm = in.readDouble();
+        entry.firstBeatSeconds = in.readDouble();
+        entry.key = in.readInt();
+        if (version >= 2)
+        {
+            entry.analysed = in.readBool();
+        }
+        else
+        {
+            //only tracks with both a tempo and a key were certainly analysed, the rest are analysed once more
+            entry.analysed = entry.bpm > 0 && entry.key >= 0;
+        }
+
+        pathIndex.set(entry.path, (int)entries.size());
+        entries.push_back(entry);
+    }
+
+    return true;
+}
+
+bool LibraryDatabase::save()
+{
+    if (!dirty)
+    {
+        return true;
+    }
+
+    databaseFile.getParentDirectory().createDirectory();
+
+    //write to a temporary file first so a crash never leaves a half written database
+    TemporaryFile temp(databaseFile);
+    {
+        FileOutputStream out(temp.getFile());
+        if (out.failedToOpen())
+        {
+            return false;
+        }
+
+        out.writeInt(databaseMagic);
+        out.writeInt(databaseVersion);
+        out.writeInt((int)entries.size());
+
+        for (const Entry& entry : entries)
+        {
+            out.writeString(entry.path);
+            out.writeInt64(entry.modificationTime);
+            out.writeInt64(entry.fileSize);
+            out.writeInt64(entry.dateAdded);
+            out.writeDouble(entry.lengthInSeconds);
+            out.writeDouble(entry.sampleRate);
+            out.writeInt(entry.numChannels);
+            out.writeDouble(entry.bpm);
+            out.writeDouble(entry.firstBeatSeconds);
+            out.writeInt(entry.key);
+            out.writeBool(entry.analysed);
+        }
+
+        out.flush();
+        if (out.getStatus().failed())
+        {
+            return false;
+        }
+    }
+
+    if (!temp.overwriteTargetFileWithTemporary())
+    {
+        return false;
+    }
+
+    dirty = false;
+    return true;
+}
+
+
+//==============================================================================
+const LibraryDatabase::Entry* LibraryDatabase::find(const String& path) const
+{
+    if (!pathIndex.contains(path))
+    {
+        return nullptr;
+    }
+    return &entries[pathIndex[path]];
+}
+
+void LibraryDatabase::update(const Entry& entry)
+{
+    if (pathIndex.contains(entry.path))
+    {
+        entries[pathIndex[entry.path]] = entry;
+    }
+    else
+    {
+        pathIndex.set(entry.path, (int)entries.size());
+        entries.push_back(entry);
+    }
+    dirty = true;
+}
@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    LibraryDatabase.h
+    Author:  Shamie
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+//===============================================================================
+/*
+    Persistent index of the music library, stored as a compact binary file in the
+    user's application data folder. Each track is keyed by its path and remembers the
+    modification time and size it had when it was last read, so unchanged files never
+    need to be opened again.
+*/
+
+class LibraryDatabase
+{
+public:
+
+    //==============================================================================
+    /**Everything known about a single track*/
+    struct Entry
+    {
+        String path;
+        int64 modificationTime = 0;
+        int64 fileSize = 0;
+        //time the track was added to the library, in milliseconds since 1970
+        int64 dateAdded = 0;
+
+        double lengthInSeconds = 0.0;
+        double sampleRate = 0.0;
+        int numChannels = 0;
+
+        //analysis results, zero or negative until the track has been analysed, or if none were found
+        double bpm = 0.0;
+        double firstBeatSeconds = 0.0;
+        int key = -1;
+        bool analysed = false;
+
+        /**True if the file on disk still has the modification time and size stored in the entry*/
+        bool matchesFile(const File& file) const;
+    };
+
+    //==============================================================================
+    /**Uses the default database file in the user's application data folder*/
+    LibraryDatabase();
+    LibraryDatabase(const File& databaseFile);
+    ~LibraryDatabase();
+
+    //==============================================================================
+    /**Replace the contents with the database file. Returns false if it is missing or unreadable*/
+    bool load();
+    /**Write the contents to the database file, if anything has changed since the last save*/
+    bool save();
+
+    //==============================================================================
+    /**All entries, in the order they were added*/
+    const std::vector<Entry>& getEntries() const { return entries; }
+    /**Entry for the given path, or nullptr if the track is not in the database*/
+    const Entry* find(const String& path) const;
+    /**Add the entry, or replace the existing entry with the same path*/
+    void update(const Entry& entry);
+
+private:
+
+    File databaseFile;
+    std::vector<Entry> entries;
+    //maps path to index in entries
+    HashMap<String, int> pathIndex;
+    bool dirty = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibraryDatabase)
+};
@@ -0,0 +1,190 @@
+/*
+  ==============================================================================
+
+    LibraryScanner.cpp
+    Author:  Shamie
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "LibraryScanner.h"
+
+//==============================================================================
+/*
+    Reads the header of one file. Only the reader is created, no audio is decoded.
+*/
+class LibraryScanner::ScanJob : public ThreadPoolJob
+{
+public:
+    ScanJob(LibraryScanner& _owner, int _trackIndex, const File& _file, const Result* _previous)
+        : ThreadPoolJob("LibraryScanner::ScanJob"),
+          owner(_owner),
+          trackIndex(_trackIndex),
+          file(_file),
+          hasPrevious(_previous != nullptr)
+    {
+        if (hasPrevious)
+        {
+            previous = *_previous;
+        }
+    }
+
+    JobStatus runJob() override
+    {
+        Result result;
+        result.trackIndex = trackIndex;
+        result.modificationTime = file.getLastModificationTime().toMilliseconds();
+        result.fileSize = file.getSize();
+
+        //unchanged since the last scan, only the file system was touched
+        if (hasPrevious
+            && file.existsAsFile()
+            && previous.modificationTime == result.modificationTime
+            && previous.fileSize == result.fileSize)
+        {
+            result = previous;
+            result.trackIndex = trackIndex;
+            result.changed = false;
+            result.cancelled = false;
+        }
+        else if (shouldExit())
+        {
+            result.cancelled = true;
+        }
+        else
+        {
+            std::unique_ptr<AudioFormatReader> reader(owner.formatManager.createReaderFor(file));
+
+            if (reader != nullptr && reader->sampleRate > 0) // good file!
+            {
+                result.readable = true;
+                result.sampleRate = reader->sampleRate;
+                result.numChannels = (int)reader->numChannels;
+                result.lengthInSeconds = reader->lengthInSamples / reader->sampleRate;
+            }
+        }
+
+        owner.addResult(result);
+        return jobHasFinished;
+    }
+
+private:
+    LibraryScanner& owner;
+    int trackIndex;
+    File file;
+    bool hasPrevious;
+    Result previous;
+};
+
+
+//==============================================================================
+LibraryScanner::LibraryScanner(AudioFormatManager& _formatManager)
+    : formatManager(_formatManager),
+      pool(SystemStats::getNumCpus())
+{
+}
+
+LibraryScanner::~LibraryScanner()
+{
+    stopTimer();
+    //stop workers before the members they report to are destroyed
+    pool.removeAllJobs(true, 5000);
+}
+
+void LibraryScanner::addListener(Listener* listener)
+{
+    listeners.add(listener);
+}
+
+void LibraryScanner::removeListener(Listener* listener)
+{
+    listeners.remove(listener);
+}
+
+
+//==============================================================================
+void LibraryScanner::scanFile(int trackIndex, const File& file, const Result* previous)
+{
+    outstandingTracks.insert(trackIndex);
+    ++numQueued;
+
+    pool.addJob(new ScanJob(*this, trackIndex, file, previous), true);
+
+    //deliver results in batches, 10 times per second
+    if (!isTimerRunning())
+    {
+        startTimer(100);
+    }
+}
+
+void LibraryScanner::cancelAll()
+{
+    //interrupt running jobs and drop the queued ones
+    pool.removeAllJobs(true, 5000);
+
+    //tracks that never got a result are reported as unreadable
+    {
+        const ScopedLock sl(resultsLock);
+        for (const Result& r : pendingResults)
+        {
+            outstandingTracks.erase(r.trackIndex);
+        }
+        for (int trackIndex : outstandingTracks)
+        {
+            Result cancelled;
+            cancelled.trackIndex = trackIndex;
+            cancelled.cancelled = true;
+            pendingResults.push_back(cancelled);
+        }
+    }
+    numCompleted = numQueued.load();
+
+    timerCallback();
+}
+
+bool LibraryScanner::isScanning() const
+{
+    return !outstandingTracks.empty();
+}
+
+
+//==============================================================================
+void LibraryScanner::addResult(const Result& result)
+{
+    const ScopedLock sl(resultsLock);
+    pendingResults.push_back(result);
+    ++numCompleted;
+}
+
+void LibraryScanner::timerCallback()
+{
+    //swap out the pending results so workers are only blocked for the swap
+    deliveredResults.clear();
+    {
+        const ScopedLock sl(resultsLock);
+        std::swap(pendingResults, deliveredResults);
+    }
+
+    for (const Result& r : deliveredResults)
+    {
+        outstandingTracks.erase(r.trackIndex);
+    }
+
+    if (!deliveredResults.empty())
+    {
+        listeners.call([this](Listener& l) { l.scanResultsReady(deliveredResults); });
+    }
+
+    const int completed = numCompleted.load();
+    const int total = numQueued.load();
+    listeners.call([completed, total](Listener& l) { l.scanProgressChanged(completed, total); });
+
+    //everything reported, reset progress for the next scan
+    if (outstandingTracks.empty())
+    {
+        numQueued = 0;
+        numCompleted = 0;
+        stopTimer();
+    }
+}
@@ -0,0 +1,106 @@
+/*
+  ==============================================================================
+
+    LibraryScanner.h
+    Author:  Shamie
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <unordered_set>
+#include <vector>
+
+//===============================================================================
+/*
+    Reads the metadata of library tracks on a pool of background threads, so that
+    dropping a large number of files onto the library never blocks the message thread.
+    Results are collected and handed back to listeners in batches on the message thread.
+*/
+
+class LibraryScanner : private Timer
+{
+public:
+
+    //==============================================================================
+    /**Metadata read from a single track*/
+    struct Result
+    {
+        int trackIndex = -1;
+        bool readable = false;
+        //true if the scan was abandoned before the file was read
+        bool cancelled = false;
+        //true if the file has been modified since it was last read, and was read again
+        bool changed = true;
+
+        int64 modificationTime = 0;
+        int64 fileSize = 0;
+
+        double lengthInSeconds = 0.0;
+        double sampleRate = 0.0;
+        int numChannels = 0;
+    };
+
+    /**Receives scan results and progress updates, always on the message thread*/
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+        /**Called with every result that has finished since the last batch*/
+        virtual void scanResultsReady(const std::vector<Result>& results) = 0;
+        /**Called after each batch with the number of completed and total files of the current scan*/
+        virtual void scanProgressChanged(int numCompleted, int numTotal) = 0;
+    };
+
+    //==============================================================================
+    LibraryScanner(AudioFormatManager& formatManager);
+    ~LibraryScanner() override;
+
+    void addListener(Listener* listener);
+    void removeListener(Listener* listener);
+
+    //==============================================================================
+    /**Queue a file to have its metadata read, identified by its index in the library.
+    If a previous result is given, the file is only opened again if its modification time or size has changed*/
+    void scanFile(int trackIndex, const File& file, const Result* previous = nullptr);
+    /**Abandon all queued and running scans. Unfinished tracks are reported as unreadable*/
+    void cancelAll();
+
+    /**True while there are files queued, being read, or waiting to be reported*/
+    bool isScanning() const;
+
+private:
+
+    class ScanJob;
+
+    //==============================================================================
+    /**Override of Timer pure virtual. Delivers collected results to listeners in one batch*/
+    void timerCallback() override;
+
+    /**Called by the worker threads once a file has been read*/
+    void addResult(const Result& result);
+
+    AudioFormatManager& formatManager;
+
+    //pool sized to use every core of the machine
+    ThreadPool pool;
+
+    //results waiting to be delivered to the message thread
+    CriticalSection resultsLock;
+    std::vector<Result> pendingResults;
+    std::vector<Result> deliveredResults;
+
+    //indices of tracks queued but not yet reported, used to report cancelled files
+    std::unordered_set<int> outstandingTracks;
+
+    //progress of the current scan, reset once everything has been reported
+    std::atomic<int> numQueued{ 0 };
+    std::atomic<int> numCompleted{ 0 };
+
+    ListenerList<Listener> listeners;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibraryScanner)
+};
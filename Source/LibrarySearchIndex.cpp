@@ -0,0 +1,157 @@
+/*
+  ==============================================================================
+
+    LibrarySearchIndex.cpp
+    Author:  Shamie
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "LibrarySearchIndex.h"
+#include <cstring>
+
+//==============================================================================
+LibrarySearchIndex::LibrarySearchIndex()
+{
+    clear();
+}
+
+void LibrarySearchIndex::clear()
+{
+    titles.clear();
+    offsets.assign(1, 0);
+    trigramRows.clear();
+    results.clear();
+    previousResults.clear();
+    previousQueryValid = false;
+}
+
+void LibrarySearchIndex::addTitle(const String& title)
+{
+    const int row = getNumTitles();
+
+    normalise(title, query);
+    titles.append(query);
+    titles.push_back('\0');
+    offsets.push_back(titles.size());
+
+    //add the row once to the list of every trigram it contains
+    for (size_t i = 0; i + 3 <= query.size(); ++i)
+    {
+        std::vector<int>& rows = trigramRows[trigramKey(query.data() + i)];
+        if (rows.empty() || rows.back() != row)
+        {
+            rows.push_back(row);
+        }
+    }
+
+    //previous results do not include the new row
+    previousQueryValid = false;
+}
+
+
+//==============================================================================
+const std::vector<int>& LibrarySearchIndex::search(const String& queryText)
+{
+    normalise(queryText, query);
+
+    //same query on an unchanged index, nothing to do
+    if (previousQueryValid && query == previousQuery)
+    {
+        return results;
+    }
+
+    if (query.empty())
+    {
+        results.resize(getNumTitles());
+        for (int row = 0; row < getNumTitles(); ++row)
+        {
+            results[row] = row;
+        }
+    }
+    //query grew, so only titles matching the previous query can still match
+    else if (previousQueryValid && query.find(previousQuery) != std::string::npos)
+    {
+        previousResults.swap(results);
+        filterRows(previousResults);
+    }
+    //start from the rows of the rarest trigram in the query
+    else if (query.size() >= 3)
+    {
+        const std::vector<int>* rarest = nullptr;
+        for (size_t i = 0; i + 3 <= query.size(); ++i)
+        {
+            auto found = trigramRows.find(trigramKey(query.data() + i));
+            if (found == trigramRows.end())
+            {
+                rarest = nullptr;
+                break;
+            }
+            if (rarest == nullptr || found->second.size() < rarest->size())
+            {
+                rarest = &found->second;
+            }
+        }
+
+        results.clear();
+        if (rarest != nullptr)
+        {
+            filterRows(*rarest);
+        }
+    }
+    //too short for the trigram index, check every title
+    else
+    {
+        results.clear();
+        for (int row = 0; row < getNumTitles(); ++row)
+        {
+            if (rowMatches(row))
+            {
+                results.push_back(row);
+            }
+        }
+    }
+
+    previousQuery = query;
+    previousQueryValid = true;
+    return results;
+}
+
+
+//==============================================================================
+void LibrarySearchIndex::normalise(const String& text, std::string& dest)
+{
+    dest.assign(text.toLowerCase().toRawUTF8());
+    for (char& c : dest)
+    {
+        if (c == '_')
+        {
+            c = ' ';
+        }
+    }
+}
+
+uint32 LibrarySearchIndex::trigramKey(const char* chars)
+{
+    return ((uint32)(uint8)chars[0] << 16)
+        | ((uint32)(uint8)chars[1] << 8)
+        | (uint32)(uint8)chars[2];
+}
+
+void LibrarySearchIndex::filterRows(const std::vector<int>& candidates)
+{
+    results.clear();
+    for (int row : candidates)
+    {
+        if (rowMatches(row))
+        {
+            results.push_back(row);
+        }
+    }
+}
+
+bool LibrarySearchIndex::rowMatches(int row) const
+{
+    return std::strstr(titles.c_str() + offsets[row], query.c_str()) != nullptr;
+}
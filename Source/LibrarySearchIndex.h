@@ -0,0 +1,72 @@
+/*
+  ==============================================================================
+
+    LibrarySearchIndex.h
+    Author:  Shamie
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//===============================================================================
+/*
+    Case-insensitive substring search over the titles in the library.
+    Titles are lower-cased once when they are added and kept in a single buffer,
+    with a trigram index pointing at the rows containing each 3 character sequence.
+    Matches are returned as row indices, in the order the titles were added.
+*/
+
+class LibrarySearchIndex
+{
+public:
+
+    LibrarySearchIndex();
+
+    //==============================================================================
+    /**Remove all titles from the index*/
+    void clear();
+    /**Add a title to the index. Its row is the number of titles added before it*/
+    void addTitle(const String& title);
+    /**Number of titles in the index*/
+    int getNumTitles() const { return (int)offsets.size() - 1; }
+
+    //==============================================================================
+    /**Returns the rows whose title contains the query, ignoring case. An empty query matches every row.
+    If the query extends the previous one, only the previous matches are checked again.
+    The returned vector is reused by the next search*/
+    const std::vector<int>& search(const String& query);
+
+private:
+
+    /**Lower-case the text and replace separators used in file names with spaces*/
+    static void normalise(const String& text, std::string& dest);
+    /**Packs 3 bytes into the key used for the trigram index*/
+    static uint32 trigramKey(const char* chars);
+
+    /**Keep the rows from candidates whose title contains the current query*/
+    void filterRows(const std::vector<int>& candidates);
+    /**True if the normalised title of the row contains the current query*/
+    bool rowMatches(int row) const;
+
+    //all normalised titles, each terminated by a null character
+    std::string titles;
+    //start of each title in titles, with one extra offset marking the end
+    std::vector<size_t> offsets;
+    //rows containing each trigram, in increasing order
+    std::unordered_map<uint32, std::vector<int>> trigramRows;
+
+    //state of the last search, reused to narrow down the next one
+    std::string query;
+    std::string previousQuery;
+    bool previousQueryValid = false;
+    std::vector<int> results;
+    std::vector<int> previousResults;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibrarySearchIndex)
+};
@@ -11,53 +11,105 @@
 //==============================================================================
 MainComponent::MainComponent()
 {
-    setSize (800, 600);
-
     // Some platforms require permissions to open input channels so request that here
     if (RuntimePermissions::isRequired (RuntimePermissions::recordAudio)
         && ! RuntimePermissions::isGranted (RuntimePermissions::recordAudio))
     {
         RuntimePermissions::request (RuntimePermissions::recordAudio,
-                                     [&] (bool granted) { if (granted)  setAudioChannels (2, 2); });
+                                     [&] (bool granted) { if (granted)  setAudioChannels (2, 4); });
     }  
     else
     {
-        // Specify the number of input and output channels that we want to open
-        setAudioChannels (0, 2);
+        // Specify the number of input and output channels that we want to open.
+        // Outputs 1-2 are the master and 3-4 the cue bus, on devices with only two outputs there is no cue bus
+        setAudioChannels (0, 4);
     }
 
     // Register file formats enabled by JUCE
     formatManager.registerBasicFormats();
 
+    // Start the disk thread shared by the decks, just below the priority of the audio thread
+    diskThread.startThread(8);
+
     // Add application components and make them visible
-    addAndMakeVisible(deckGUILeft);
-    addAndMakeVisible(deckGUIRight);
+    for (int deckIndex = 0; deckIndex < deckManager.getNumDecks(); ++deckIndex)
+    {
+        DeckGUI* deckGUI = deckGUIs.add(new DeckGUI(deckManager, &playlistComponent,
+            formatManager, thumbCache, pcmCache, displayScheduler, deckIndex));
+        addAndMakeVisible(deckGUI);
+    }
     addAndMakeVisible(playlistComponent);
 
     // Add Labels and customize visuals for labels 
-    addAndMakeVisible(waveformLabel);
-    waveformLabel.setText("Waveforms", juce::dontSendNotification);
-    waveformLabel.setColour(juce::Label::textColourId, juce::Colours::whitesmoke);
-    waveformLabel.setJustificationType(juce::Justification::centred);
-    addAndMakeVisible(posLabel);
-    posLabel.setText("Playback", juce::dontSendNotification);
-    posLabel.setColour(juce::Label::textColourId, juce::Colours::whitesmoke);
-    posLabel.setJustificationType(juce::Justification::centred);
-    addAndMakeVisible(widgetLabel);
-    widgetLabel.setText("Widgets Controls", juce::dontSendNotification);
-    widgetLabel.setColour(juce::Label::textColourId, juce::Colours::whitesmoke);
-    widgetLabel.setJustificationType(juce::Justification::centred);
-    addAndMakeVisible(playlistLabel);
-    playlistLabel.setText("Drag Files here to add to Library", juce::dontSendNotification);
-    playlistLabel.setColour(juce::Label::textColourId, juce::Colours::whitesmoke);
-    playlistLabel.setJustificationType(juce::Justification::centred);
+    for (int row = 0; row < getNumDeckRows(); ++row)
+    {
+        addSideLabel(*waveformLabels.add(new Label()), "Waveforms");
+        addSideLabel(*posLabels.add(new Label()), "Playback");
+        addSideLabel(*widgetLabels.add(new Label()), "Widgets Controls");
+    }
+    addSideLabel(playlistLabel, "Drag Files here to add to Library");
+
+    // Add crossfader below the playlist label
+    addAndMakeVisible(crossfaderSlider);
+    crossfaderSlider.setSliderStyle(Slider::SliderStyle::LinearHorizontal);
+    crossfaderSlider.setTextBoxStyle(Slider::NoTextBox, false, 0, 0);
+    crossfaderSlider.setRange(0.0, 1.0);
+    crossfaderSlider.setValue(0.5);
+    crossfaderSlider.setDoubleClickReturnValue(true, 0.5);
+    crossfaderSlider.addListener(this);
+    addAndMakeVisible(crossfaderCurveBox);
+    crossfaderCurveBox.addItem("Constant Power", 1 + DeckMixer::constantPowerCurve);
+    crossfaderCurveBox.addItem("Linear", 1 + DeckMixer::linearCurve);
+    crossfaderCurveBox.addItem("Cut", 1 + DeckMixer::cutCurve);
+    crossfaderCurveBox.setSelectedId(1 + DeckMixer::constantPowerCurve, juce::dontSendNotification);
+    crossfaderCurveBox.addListener(this);
+    addAndMakeVisible(crossfaderLabel);
+    crossfaderLabel.setText("Crossfader", juce::dontSendNotification);
+    crossfaderLabel.setColour(juce::Label::textColourId, juce::Colours::whitesmoke);
+    crossfaderLabel.attachToComponent(&crossfaderSlider, false);
+
+    // Add cue mix for the headphone outputs, all cue to the left and all master to the right
+    addAndMakeVisible(cueMixSlider);
+    cueMixSlider.setSliderStyle(Slider::SliderStyle::LinearHorizontal);
+    cueMixSlider.setTextBoxStyle(Slider::NoTextBox, false, 0, 0);
+    cueMixSlider.setRange(0.0, 1.0);
+    cueMixSlider.setValue(0.0);
+    cueMixSlider.addListener(this);
+    addAndMakeVisible(cueMixLabel);
+    cueMixLabel.setText("Cue / Master", juce::dontSendNotification);
+    cueMixLabel.setColour(juce::Label::textColourId, juce::Colours::whitesmoke);
+    cueMixLabel.attachToComponent(&cueMixSlider, false);
+
+    // Add the resampler quality used by every deck when key lock is off
+    addAndMakeVisible(resamplerQualityBox);
+    resamplerQualityBox.addItem("Draft", 1 + PolyphaseResamplingAudioSource::draft);
+    resamplerQualityBox.addItem("Normal", 1 + PolyphaseResamplingAudioSource::normal);
+    resamplerQualityBox.addItem("High", 1 + PolyphaseResamplingAudioSource::high);
+    resamplerQualityBox.setSelectedId(1 + PolyphaseResamplingAudioSource::normal, juce::dontSendNotification);
+    resamplerQualityBox.addListener(this);
+    addAndMakeVisible(resamplerQualityLabel);
+    resamplerQualityLabel.setText("Resampler", juce::dontSendNotification);
+    resamplerQualityLabel.setColour(juce::Label::textColourId, juce::Colours::whitesmoke);
+    resamplerQualityLabel.attachToComponent(&resamplerQualityBox, true);
+
+    //sized once every component exists. Each extra row of decks makes the window taller, but never taller
+    //than the screen, and the rows share whatever height there is
+    const int maxHeight = Desktop::getInstance().getDisplays().getMainDisplay().userArea.getHeight() - 40;
+    setSize (800, jmax(600, jmin(240 + 400 * getNumDeckRows(), maxHeight)));
 
+    // Paint through OpenGL if asked to, falling back to software rendering if it is not available
+    if (JUCEApplication::getCommandLineParameterArray().contains("--opengl"))
+    {
+        setOpenGLRendering(true);
+    }
 }
 
 MainComponent::~MainComponent()
 {
     // This shuts down the audio device and clears the audio source.
     shutdownAudio();
+
+    setOpenGLRendering(false);
 }
 
 
@@ -66,19 +118,23 @@ void MainComponent::prepareToPlay (int samplesPerBlockExpected, double sampleRat
 {
     playlistComponent.prepareToPlay(samplesPerBlockExpected, sampleRate);
 
-    playerLeft.prepareToPlay(samplesPerBlockExpected, sampleRate);
-    playerRight.prepareToPlay(samplesPerBlockExpected, sampleRate);
-
-    mixerSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
-
-    mixerSource.addInputSource(&playerLeft, false); 
-    mixerSource.addInputSource(&playerRight, false);
+    deckManager.prepareToPlay(samplesPerBlockExpected, sampleRate);
 
+    //a block is heard after the device's own latency plus the time to play the block itself,
+    //so the playheads are drawn that far behind the audio thread
+    if (AudioIODevice* device = deviceManager.getCurrentAudioDevice())
+    {
+        const double latency = (device->getOutputLatencyInSamples() + samplesPerBlockExpected) / sampleRate;
+        for (int deckIndex = 0; deckIndex < deckManager.getNumDecks(); ++deckIndex)
+        {
+            deckManager.getPlayer(deckIndex)->setOutputLatency(latency);
+        }
+    }
  }
 
 void MainComponent::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill)
 {
-    mixerSource.getNextAudioBlock(bufferToFill);
+    deckManager.getNextAudioBlock(bufferToFill);
 }
 
 void MainComponent::releaseResources()
@@ -87,8 +143,7 @@ void MainComponent::releaseResources()
 
     playlistComponent.releaseResources();
 
-    playerLeft.releaseResources();
-    playerRight.releaseResources();
+    deckManager.releaseResources();
 }
 
 //==============================================================================
@@ -99,21 +154,149 @@ void MainComponent::paint (Graphics& g)
 
 void MainComponent::resized()
 {
-    double rowH = getHeight() / 10;
     double colW = getWidth() / 7;
 
-    //position labels to left side of screen
-    waveformLabel.setBounds(0, 0, colW, rowH*2);
-    posLabel.setBounds(0, rowH*2, colW, rowH);
-    widgetLabel.setBounds(0, rowH*3, colW, rowH*3);
-    playlistLabel.setBounds(0, rowH*6, colW, rowH*3);
+    //the playlist keeps 240 pixels, or 40% of a small window, and the decks share the rest
+    double playlistH = jmin(240.0, getHeight() * 0.4);
+    double deckRowH = (getHeight() - playlistH) / getNumDeckRows();
+    double rowH = deckRowH / 7;
+
+    for (int row = 0; row < getNumDeckRows(); ++row)
+    {
+        double top = deckRowH * row;
+
+        //position labels to left side of screen
+        waveformLabels[row]->setBounds(0, top, colW, rowH * 2);
+        posLabels[row]->setBounds(0, top + rowH * 2, colW, rowH);
+        widgetLabels[row]->setBounds(0, top + rowH * 3, colW, rowH * 4);
+    }
+    //the crossfader, cue mix and resampler quality sit under the playlist label, with their labels attached
+    double mixerTop = getHeight() - playlistH * 0.7;
+    playlistLabel.setBounds(0, getHeight() - playlistH, colW, playlistH * 0.3);
+    crossfaderSlider.setBounds(5, mixerTop + 20, colW - 10, 24);
+    crossfaderCurveBox.setBounds(5, mixerTop + 48, colW - 10, 22);
+    cueMixSlider.setBounds(5, mixerTop + 96, colW - 10, 24);
+    resamplerQualityBox.setBounds(colW * 0.5, mixerTop + 126, colW * 0.5 - 5, 22);
 
-    //add GUIs
-    deckGUILeft.setBounds(colW, 0, colW * 3, rowH*6);
-    deckGUIRight.setBounds(colW * 4, 0, colW * 3, rowH * 6);
+    //add GUIs, two to a row
+    for (int deckIndex = 0; deckIndex < deckGUIs.size(); ++deckIndex)
+    {
+        deckGUIs[deckIndex]->setBounds(colW + colW * 3 * (deckIndex % 2), deckRowH * (deckIndex / 2), colW * 3, deckRowH);
+    }
 
     //add playlist
-    playlistComponent.setBounds(colW, rowH *6, colW * 6, rowH * 4);
+    playlistComponent.setBounds(colW, getHeight() - playlistH, colW * 6, playlistH);
+
+}
+
+
+//==============================================================================
+void MainComponent::setOpenGLRendering(bool shouldUseOpenGL)
+{
+    if (shouldUseOpenGL == isOpenGLRendering())
+    {
+        return;
+    }
+
+    if (shouldUseOpenGL)
+    {
+        //children are painted by JUCE's OpenGL renderer, and cached images become textures
+        openGLContextCreated = false;
+        openGLContext.setRenderer(this);
+        openGLContext.setComponentPaintingEnabled(true);
+        openGLContext.attachTo(*this);
+
+        //the context is created on its own thread, give it time before falling back
+        startTimer(2000);
+    }
+    else
+    {
+        stopTimer();
+        openGLContext.detach();
+        openGLContext.setRenderer(nullptr);
+    }
+}
+
+bool MainComponent::isOpenGLRendering() const
+{
+    return openGLContext.isAttached();
+}
+
+void MainComponent::newOpenGLContextCreated()
+{
+    openGLContextCreated = true;
+}
+
+void MainComponent::renderOpenGL()
+{
+    OpenGLHelpers::clear(Colours::black);
+}
+
+void MainComponent::openGLContextClosing()
+{
+}
+
+void MainComponent::timerCallback()
+{
+    stopTimer();
+    if (!openGLContextCreated)
+    {
+        Logger::writeToLog("OpenGL context could not be created, using the software renderer");
+        setOpenGLRendering(false);
+    }
+}
+
+
+void MainComponent::sliderValueChanged(Slider* slider)
+{
+    if (slider == &crossfaderSlider)
+    {
+        deckManager.getMixer().setCrossfader((float)crossfaderSlider.getValue());
+    }
+    if (slider == &cueMixSlider)
+    {
+        deckManager.getMixer().setCueMix((float)cueMixSlider.getValue());
+    }
+}
+
+void MainComponent::comboBoxChanged(ComboBox* comboBox)
+{
+    if (comboBox == &crossfaderCurveBox)
+    {
+        deckManager.getMixer().setCrossfaderCurve((DeckMixer::CrossfaderCurve)(crossfaderCurveBox.getSelectedId() - 1));
+    }
+    if (comboBox == &resamplerQualityBox)
+    {
+        for (int deckIndex = 0; deckIndex < deckManager.getNumDecks(); ++deckIndex)
+        {
+            deckManager.getPlayer(deckIndex)->setResamplerQuality(
+                (PolyphaseResamplingAudioSource::Quality)(resamplerQualityBox.getSelectedId() - 1));
+        }
+    }
+}
+
+//==============================================================================
+int MainComponent::getConfiguredNumDecks()
+{
+    for (const String& parameter : JUCEApplication::getCommandLineParameterArray())
+    {
+        if (parameter.startsWith("--decks="))
+        {
+            return jlimit(2, 8, parameter.fromFirstOccurrenceOf("=", false, false).getIntValue());
+        }
+    }
+    return 4;
+}
 
+int MainComponent::getNumDeckRows() const
+{
+    return (deckManager.getNumDecks() + 1) / 2;
 }
 
+void MainComponent::addSideLabel(Label& label, const String& text)
+{
+    addAndMakeVisible(label);
+    label.setText(text, juce::dontSendNotification);
+    label.setColour(juce::Label::textColourId, juce::Colours::whitesmoke);
+    label.setJustificationType(juce::Justification::centred);
+}
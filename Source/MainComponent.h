@@ -9,10 +9,16 @@
 
 #pragma once
 
-#include "../JuceLibraryCode/JuceHeader.h"
+#include <JuceHeader.h>
 #include "DJAudioPlayer.h"
+#include "DeckManager.h"
+#include "DecodedTrackCache.h"
+#include "PcmFileCache.h"
+#include "DiskThumbnailCache.h"
+#include "DisplayScheduler.h"
 #include "DeckGUI.h"
 #include "PlaylistComponent.h"
+#include <atomic>
 
 
 //==============================================================================
@@ -20,7 +26,11 @@
     This component lives inside our window, and this is where you should put all
     your controls and content.
 */
-class MainComponent   : public AudioAppComponent
+class MainComponent   : public AudioAppComponent,
+                        private OpenGLRenderer,
+                        private Timer,
+                        private Slider::Listener,
+                        private ComboBox::Listener
 {
 public:
 
@@ -45,30 +55,85 @@ public:
     void resized() override;
 
 
+    //==============================================================================
+    /**Paint the whole window through OpenGL, or go back to the software renderer.
+    If no OpenGL context can be created the window stays on the software renderer*/
+    void setOpenGLRendering(bool shouldUseOpenGL);
+    bool isOpenGLRendering() const;
+
+
 private:
 
+    //==============================================================================
+    /**Override of OpenGLRenderer pure virtual. Records that the context was created*/
+    void newOpenGLContextCreated() override;
+    /**Override of OpenGLRenderer pure virtual. Components paint themselves, nothing else is drawn*/
+    void renderOpenGL() override;
+    /**Override of OpenGLRenderer pure virtual*/
+    void openGLContextClosing() override;
+    /**Override of Timer pure virtual. Falls back to software rendering if the context never started*/
+    void timerCallback() override;
+    /**Override of Slider::Listener pure virtual. Sends the crossfader position and cue mix to the mixer*/
+    void sliderValueChanged(Slider* slider) override;
+    /**Override of ComboBox::Listener pure virtual. Sends the crossfader curve to the mixer, and the resampler quality to every deck*/
+    void comboBoxChanged(ComboBox* comboBox) override;
+
+    /**Number of decks, 4 unless set with --decks=N on the command line*/
+    static int getConfiguredNumDecks();
+    /**Number of rows the decks are laid out in, two decks to a row*/
+    int getNumDeckRows() const;
+    /**Add a centred label down the left side of the window*/
+    void addSideLabel(Label& label, const String& text);
+
     //==============================================================================
     AudioFormatManager formatManager; 
-    AudioThumbnailCache thumbCache{ 100 }; //cache up to 100 files 
 
-    int channelL = 0;
-    int channelR = 1;
+    //reads ahead of the playhead for every deck, so decoding never happens in the audio callback
+    TimeSliceThread diskThread{ "Deck disk reader" };
+    //tracks decoded into memory for decks in RAM-resident mode, shared by every deck (1 GB)
+    DecodedTrackCache decodedTracks{ (int64)1024 * 1024 * 1024 };
+    //tracks decoded once to float WAV files on disk, shared by playback and the waveforms (8 GB)
+    PcmFileCache pcmCache{ formatManager,
+        File::getSpecialLocation(File::userApplicationDataDirectory).getChildFile("OtoDecks").getChildFile("PcmCache"),
+        (int64)8 * 1024 * 1024 * 1024 };
+    //waveform thumbnails, up to 100 files in memory and every finished one on disk
+    DiskThumbnailCache thumbCache{ 100,
+        File::getSpecialLocation(File::userApplicationDataDirectory).getChildFile("OtoDecks").getChildFile("Thumbnails"),
+        formatManager,
+        pcmCache };
+
+    //frame timer for the playheads, meters and up next lists of every deck
+    DisplayScheduler displayScheduler;
 
-    PlaylistComponent playlistComponent{formatManager};
-    DJAudioPlayer playerLeft{formatManager};
-    DeckGUI deckGUILeft{&playerLeft,&playlistComponent, formatManager, thumbCache, channelL};
+    //players for every deck, rendered in parallel and mixed together
+    DeckManager deckManager{ getConfiguredNumDecks(), formatManager, diskThread, decodedTracks, pcmCache };
 
-    DJAudioPlayer playerRight{ formatManager };
-    DeckGUI deckGUIRight{&playerRight, &playlistComponent, formatManager, thumbCache, channelR};
+    PlaylistComponent playlistComponent{ formatManager, thumbCache, pcmCache, deckManager.getNumDecks() };
+
+    //one GUI per deck, destroyed before the players they control
+    OwnedArray<DeckGUI> deckGUIs;
 
     //==============================================================================
-    Label waveformLabel;
-    Label posLabel;
-    Label widgetLabel;
+    //labels for each row of decks
+    OwnedArray<Label> waveformLabels;
+    OwnedArray<Label> posLabels;
+    OwnedArray<Label> widgetLabels;
     Label playlistLabel;
 
-    //==============================================================================
-    MixerAudioSource mixerSource; 
+    //crossfader between the decks on side A and side B, and the shape of its fade
+    Slider crossfaderSlider;
+    ComboBox crossfaderCurveBox;
+    Label crossfaderLabel;
+    //blend of the decks being cued with the master on the headphone outputs
+    Slider cueMixSlider;
+    Label cueMixLabel;
+    //filter length of every deck's resampler, trading CPU for less aliasing when sped up
+    ComboBox resamplerQualityBox;
+    Label resamplerQualityLabel;
+
+    //optional OpenGL renderer for the whole window, enabled with --opengl on the command line
+    OpenGLContext openGLContext;
+    std::atomic<bool> openGLContextCreated{ false };
 
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MainComponent); 
@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+    PcmBufferSource.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "PcmBufferSource.h"
+
+PcmBufferSource::PcmBufferSource(DecodedTrackCache::TrackPtr _track)
+    : track(_track)
+{}
+
+PcmBufferSource::~PcmBufferSource()
+{}
+
+//==============================================================================
+void PcmBufferSource::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{}
+
+void PcmBufferSource::releaseResources()
+{}
+
+void PcmBufferSource::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
+{
+    const AudioBuffer<float>& audio = track->audio;
+    const int totalLength = audio.getNumSamples();
+    const int numSourceChannels = audio.getNumChannels();
+
+    int64 readPos = position.load();
+    int destOffset = 0;
+    int remaining = bufferToFill.numSamples;
+
+    while (remaining > 0)
+    {
+        if (looping && totalLength > 0)
+        {
+            readPos %= totalLength;
+        }
+
+        //past the end of the track, the rest of the block is silent
+        if (readPos < 0 || readPos >= totalLength)
+        {
+            bufferToFill.buffer->clear(bufferToFill.startSample + destOffset, remaining);
+            readPos += remaining;
+            break;
+        }
+
+        const int numToCopy = (int)jmin((int64)remaining, totalLength - readPos);
+        for (int channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
+        {
+            //mono tracks are played on every channel
+            bufferToFill.buffer->copyFrom(channel,
+                bufferToFill.startSample + destOffset,
+                audio,
+                jmin(channel, numSourceChannels - 1),
+                (int)readPos,
+                numToCopy);
+        }
+
+        readPos += numToCopy;
+        destOffset += numToCopy;
+        remaining -= numToCopy;
+    }
+
+    position = readPos;
+}
+
+
+//==============================================================================
+void PcmBufferSource::setNextReadPosition(int64 newPosition)
+{
+    position = newPosition;
+}
+
+int64 PcmBufferSource::getNextReadPosition() const
+{
+    const int64 totalLength = getTotalLength();
+    const int64 pos = position.load();
+    return (looping && totalLength > 0) ? pos % totalLength : pos;
+}
+
+int64 PcmBufferSource::getTotalLength() const
+{
+    return track->audio.getNumSamples();
+}
+
+bool PcmBufferSource::isLooping() const
+{
+    return looping;
+}
+
+void PcmBufferSource::setLooping(bool shouldLoop)
+{
+    looping = shouldLoop;
+}
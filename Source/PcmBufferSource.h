@@ -0,0 +1,45 @@
+/*
+  ==============================================================================
+    PcmBufferSource.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "DecodedTrackCache.h"
+#include <atomic>
+
+//===============================================================================
+/*
+    Plays a track that has been decoded into memory. Reading and seeking only copy
+    from the buffer, so playback never touches the decoder or the disk.
+*/
+class PcmBufferSource : public PositionableAudioSource
+{
+public:
+
+    PcmBufferSource(DecodedTrackCache::TrackPtr track);
+    ~PcmBufferSource();
+
+    //==============================================================================
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override;
+
+    //==============================================================================
+    void setNextReadPosition(int64 newPosition) override;
+    int64 getNextReadPosition() const override;
+    int64 getTotalLength() const override;
+    bool isLooping() const override;
+    void setLooping(bool shouldLoop) override;
+
+private:
+    //==============================================================================
+    DecodedTrackCache::TrackPtr track;
+    std::atomic<int64> position{ 0 };
+    bool looping = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PcmBufferSource)
+};
@@ -0,0 +1,320 @@
+/*
+  ==============================================================================
+    PcmFileCache.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "PcmFileCache.h"
+
+//==============================================================================
+class PcmFileCache::DecodeJob : public ThreadPoolJob
+{
+public:
+    DecodeJob(PcmFileCache& _owner, const URL& _audioURL)
+        : ThreadPoolJob("PcmFileCache::DecodeJob"),
+          owner(_owner),
+          audioURL(_audioURL)
+    {}
+
+    JobStatus runJob() override
+    {
+        {
+            const ScopedLock sl(owner.lock);
+            owner.filesQueued.removeString(owner.getCacheFileFor(audioURL).getFullPathName());
+        }
+        owner.writeCacheFile(audioURL, this);
+        return jobHasFinished;
+    }
+
+private:
+    PcmFileCache& owner;
+    URL audioURL;
+};
+
+//==============================================================================
+class PcmFileCache::CachedInputSource : public InputSource
+{
+public:
+    CachedInputSource(PcmFileCache& _owner, const URL& _audioURL)
+        : owner(_owner),
+          audioURL(_audioURL)
+    {}
+
+    InputStream* createInputStream() override
+    {
+        File cachedFile = owner.findCachedFile(audioURL);
+        if (cachedFile.existsAsFile())
+        {
+            return cachedFile.createInputStream();
+        }
+        return audioURL.createInputStream(false);
+    }
+
+    InputStream* createInputStreamFor(const String& relatedItemPath) override
+    {
+        return audioURL.getChildURL(relatedItemPath).createInputStream(false);
+    }
+
+    int64 hashCode() const override
+    {
+        return PcmFileCache::getTrackHash(audioURL);
+    }
+
+private:
+    PcmFileCache& owner;
+    URL audioURL;
+};
+
+
+//==============================================================================
+PcmFileCache::PcmFileCache(AudioFormatManager& _formatManager, const File& _cacheDirectory, int64 _maxCacheBytes)
+    : formatManager(_formatManager),
+      cacheDirectory(_cacheDirectory),
+      maxCacheBytes(_maxCacheBytes)
+{
+    cacheDirectory.createDirectory();
+
+    //remove files left half written by a previous session
+    for (const File& partial : cacheDirectory.findChildFiles(File::findFiles, false, "*.partial"))
+    {
+        partial.deleteFile();
+    }
+
+    //the only full scan until the cache outgrows its limit
+    for (const File& f : cacheDirectory.findChildFiles(File::findFiles, false, "*.wav"))
+    {
+        cacheBytes += f.getSize();
+    }
+}
+
+PcmFileCache::~PcmFileCache()
+{
+    pool.removeAllJobs(true, 10000);
+}
+
+
+//==============================================================================
+File PcmFileCache::findCachedFile(const URL& audioURL)
+{
+    File cacheFile = getCacheFileFor(audioURL);
+
+    const ScopedLock sl(lock);
+    if (!cacheFile.existsAsFile() || filesInProgress.contains(cacheFile.getFullPathName()))
+    {
+        return File();
+    }
+    return cacheFile;
+}
+
+void PcmFileCache::markUsed(const URL& audioURL)
+{
+    //the modification time of a cache file records when it was last used
+    File cacheFile = findCachedFile(audioURL);
+    if (cacheFile.existsAsFile())
+    {
+        cacheFile.setLastModificationTime(Time::getCurrentTime());
+    }
+}
+
+MemoryMappedAudioFormatReader* PcmFileCache::createMappedReader(const URL& audioURL)
+{
+    File cacheFile = findCachedFile(audioURL);
+    if (!cacheFile.existsAsFile())
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<MemoryMappedAudioFormatReader> reader(wavFormat.createMemoryMappedReader(cacheFile));
+    if (reader == nullptr || !reader->mapEntireFile())
+    {
+        return nullptr;
+    }
+    return reader.release();
+}
+
+InputSource* PcmFileCache::createInputSource(const URL& audioURL)
+{
+    return new CachedInputSource(*this, audioURL);
+}
+
+void PcmFileCache::cacheInBackground(const URL& audioURL, int64 decodedBytes)
+{
+    //a track bigger than the whole cache would only push everything else out, then be deleted itself
+    File cacheFile = getCacheFileFor(audioURL);
+    if (cacheFile == File() || cacheFile.existsAsFile() || decodedBytes > maxCacheBytes)
+    {
+        return;
+    }
+
+    const ScopedLock sl(lock);
+    if (!filesQueued.contains(cacheFile.getFullPathName()) && !filesInProgress.contains(cacheFile.getFullPathName()))
+    {
+        filesQueued.add(cacheFile.getFullPathName());
+        pool.addJob(new DecodeJob(*this, audioURL), true);
+    }
+}
+
+File PcmFileCache::cacheNow(const URL& audioURL)
+{
+    return writeCacheFile(audioURL, nullptr);
+}
+
+
+//==============================================================================
+File PcmFileCache::writeCacheFile(const URL& audioURL, ThreadPoolJob* job)
+{
+    File cacheFile = getCacheFileFor(audioURL);
+    if (cacheFile == File())
+    {
+        return File();
+    }
+
+    {
+        const ScopedLock sl(lock);
+        if (filesInProgress.contains(cacheFile.getFullPathName()))
+        {
+            return File();
+        }
+        if (cacheFile.existsAsFile())
+        {
+            return cacheFile;
+        }
+        filesInProgress.add(cacheFile.getFullPathName());
+    }
+
+    //decode to a partial file, renamed once complete so readers never map a half written file
+    File partialFile = cacheFile.withFileExtension("partial");
+    bool written = false;
+    {
+        std::unique_ptr<AudioFormatReader> reader(formatManager.createReaderFor(audioURL.createInputStream(false)));
+        std::unique_ptr<FileOutputStream> out(partialFile.createOutputStream());
+
+        if (reader != nullptr && out != nullptr)
+        {
+            std::unique_ptr<AudioFormatWriter> writer(wavFormat.createWriterFor(out.get(),
+                reader->sampleRate,
+                jlimit(1u, 2u, reader->numChannels),
+                32, //float samples
+                {},
+                0));
+            if (writer != nullptr)
+            {
+                out.release(); //now owned by the writer
+                written = copySamples(*reader, *writer, job);
+            }
+        }
+    }
+
+    written = written && partialFile.moveFileTo(cacheFile);
+    if (!written)
+    {
+        partialFile.deleteFile();
+    }
+
+    {
+        const ScopedLock sl(lock);
+        filesInProgress.removeString(cacheFile.getFullPathName());
+        if (written)
+        {
+            cacheBytes += cacheFile.getSize();
+        }
+    }
+
+    enforceSizeLimit();
+    return written ? cacheFile : File();
+}
+
+bool PcmFileCache::copySamples(AudioFormatReader& reader, AudioFormatWriter& writer, ThreadPoolJob* job)
+{
+    //decode in blocks, so shutting down does not wait for a whole track to be decoded
+    const int blockSize = 65536;
+    AudioBuffer<float> buffer((int)writer.getNumChannels(), blockSize);
+
+    for (int64 pos = 0; pos < reader.lengthInSamples; pos += blockSize)
+    {
+        if (job != nullptr && job->shouldExit())
+        {
+            return false;
+        }
+
+        const int numSamples = (int)jmin((int64)blockSize, reader.lengthInSamples - pos);
+        if (!reader.read(&buffer, 0, numSamples, pos, true, buffer.getNumChannels() > 1)
+            || !writer.writeFromAudioSampleBuffer(buffer, 0, numSamples))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int64 PcmFileCache::getTrackHash(const URL& audioURL)
+{
+    if (!audioURL.isLocalFile())
+    {
+        return audioURL.toString(true).hashCode64();
+    }
+
+    File source = audioURL.getLocalFile();
+    return getTrackHash(source, source.getSize(), source.getLastModificationTime().toMilliseconds());
+}
+
+int64 PcmFileCache::getTrackHash(const File& file, int64 fileSize, int64 modificationTime)
+{
+    String key = file.getFullPathName()
+        + ":" + String(fileSize)
+        + ":" + String(modificationTime);
+    return key.hashCode64();
+}
+
+File PcmFileCache::getCacheFileFor(const URL& audioURL) const
+{
+    if (!audioURL.isLocalFile())
+    {
+        return File();
+    }
+    return cacheDirectory.getChildFile(String::toHexString(getTrackHash(audioURL)) + ".wav");
+}
+
+void PcmFileCache::enforceSizeLimit()
+{
+    {
+        const ScopedLock sl(lock);
+        if (cacheBytes <= maxCacheBytes)
+        {
+            return;
+        }
+    }
+
+    Array<File> files = cacheDirectory.findChildFiles(File::findFiles, false, "*.wav");
+
+    int64 totalBytes = 0;
+    for (const File& f : files)
+    {
+        totalBytes += f.getSize();
+    }
+
+    //oldest first
+    std::sort(files.begin(), files.end(), [](const File& a, const File& b)
+    {
+        return a.getLastModificationTime() < b.getLastModificationTime();
+    });
+
+    const ScopedLock sl(lock);
+    for (const File& f : files)
+    {
+        if (totalBytes <= maxCacheBytes)
+        {
+            break;
+        }
+        //files still being written are not in this list, as they end in .partial.
+        //On Windows a file mapped by a deck cannot be deleted, and is skipped until it is released
+        int64 size = f.getSize();
+        if (f.deleteFile())
+        {
+            totalBytes -= size;
+        }
+    }
+    //taken from the scan, so files that could not be deleted are still counted
+    cacheBytes = totalBytes;
+}
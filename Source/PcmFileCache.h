@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+    PcmFileCache.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//===============================================================================
+/*
+    On-disk cache of decoded tracks, stored as 32-bit float WAV files that can be memory mapped.
+    Each track is decoded once in the background; playback, waveform drawing and analysis then
+    read the mapped samples directly instead of decoding the original file again.
+    The total size of the cache is kept under a limit by deleting the least recently used files.
+    The size is kept as a running total, so the directory is only scanned when the limit is passed.
+*/
+class PcmFileCache
+{
+public:
+
+    PcmFileCache(AudioFormatManager& formatManager, const File& cacheDirectory, int64 maxCacheBytes);
+    ~PcmFileCache();
+
+    //==============================================================================
+    /**Returns the cached PCM file for the track, or a non-existent File if it has not been decoded yet*/
+    File findCachedFile(const URL& audioURL);
+    /**Record that the track's cache file has just been used, so it is among the last to be deleted.
+    Called once each time the track is loaded to a deck, not on every lookup*/
+    void markUsed(const URL& audioURL);
+    /**Returns a reader with the whole cached PCM file mapped into memory, or nullptr if the track
+    has not been decoded yet. The caller owns the reader*/
+    MemoryMappedAudioFormatReader* createMappedReader(const URL& audioURL);
+
+    /**Returns an InputSource for the track that reads the cached PCM file once it exists, and the original
+    file until then. Its hash identifies the original file's path, size and modification time.
+    The caller owns the source*/
+    InputSource* createInputSource(const URL& audioURL);
+
+    /**Identifies the track by its path, size and modification time, so edited files get a new hash*/
+    static int64 getTrackHash(const URL& audioURL);
+    /**The same hash from a size and modification time already read, without touching the file*/
+    static int64 getTrackHash(const File& file, int64 fileSize, int64 modificationTime);
+
+    /**Decode the track into the cache on a background thread, unless it is already cached or queued,
+    or its decoded size in bytes would not fit in the cache*/
+    void cacheInBackground(const URL& audioURL, int64 decodedBytes);
+    /**Decode the track into the cache on the calling thread, unless it is already cached.
+    Returns the cached file, or a non-existent File if the track could not be decoded*/
+    File cacheNow(const URL& audioURL);
+
+private:
+    //==============================================================================
+    class DecodeJob;
+    class CachedInputSource;
+
+    /**Decode the track into its cache file unless it is already cached or being written.
+    Stops early if the job is asked to exit*/
+    File writeCacheFile(const URL& audioURL, ThreadPoolJob* job);
+    /**Copy every sample from the reader to the writer, a block at a time*/
+    static bool copySamples(AudioFormatReader& reader, AudioFormatWriter& writer, ThreadPoolJob* job);
+
+    /**Name of the cache file for the track, from its hash*/
+    File getCacheFileFor(const URL& audioURL) const;
+    /**Delete least recently used files until the cache fits in the size limit*/
+    void enforceSizeLimit();
+
+    AudioFormatManager& formatManager;
+    WavAudioFormat wavFormat;
+    File cacheDirectory;
+    int64 maxCacheBytes;
+
+    //cache files currently being written, so a track is never decoded twice at the same time,
+    //and those waiting to be, so a track loaded again before its turn is not queued twice
+    CriticalSection lock;
+    StringArray filesInProgress;
+    StringArray filesQueued;
+    //total size of the cache files
+    int64 cacheBytes = 0;
+
+    //single background thread, so decoding never competes with more than one core
+    ThreadPool pool{ 1 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PcmFileCache)
+};
@@ -9,16 +9,43 @@
 
 #include <JuceHeader.h>
 #include "PlaylistComponent.h"
+#include "KeyDetector.h"
+
+namespace
+{
+    //metadata of a track as it was last saved, so the scanner can tell whether the file changed
+    LibraryScanner::Result resultFromEntry(const LibraryDatabase::Entry& entry)
+    {
+        LibraryScanner::Result result;
+        result.readable = true;
+        result.modificationTime = entry.modificationTime;
+        result.fileSize = entry.fileSize;
+        result.lengthInSeconds = entry.lengthInSeconds;
+        result.sampleRate = entry.sampleRate;
+        result.numChannels = entry.numChannels;
+        return result;
+    }
+}
 
 //==============================================================================
-PlaylistComponent::PlaylistComponent(AudioFormatManager& _formatManager)
-    : formatManager(_formatManager)
+PlaylistComponent::PlaylistComponent(AudioFormatManager& _formatManager, DiskThumbnailCache& _thumbCache, PcmFileCache& _pcmCache, int numDecks)
+    : formatManager(_formatManager),
+      thumbCache(_thumbCache),
+      pcmCache(_pcmCache),
+      upNextLists((size_t)numDecks)
 {
     //set up playlist library table 
     tableComponent.getHeader().addColumn("Track Title",1, 250);
     tableComponent.getHeader().addColumn("Duration", 2, 100);
-    tableComponent.getHeader().addColumn("Add to L", 3, 100);
-    tableComponent.getHeader().addColumn("Add to R", 4, 100);
+    tableComponent.getHeader().addColumn("BPM", 5, 60);
+    tableComponent.getHeader().addColumn("Key", 6, 80);
+    tableComponent.getHeader().addColumn("Date Added", 7, 100);
+    //a button column for each deck, which cannot be sorted
+    for (int deckIndex = 0; deckIndex < numDecks; ++deckIndex)
+    {
+        tableComponent.getHeader().addColumn("Add to " + String(deckIndex + 1), firstDeckColumnId + deckIndex,
+            70, 30, -1, TableHeaderComponent::notSortable);
+    }
     tableComponent.setModel(this);
     addAndMakeVisible(tableComponent);
 
@@ -29,10 +56,41 @@ PlaylistComponent::PlaylistComponent(AudioFormatManager& _formatManager)
     addAndMakeVisible(searchLabel);
     searchLabel.setText("Find Track: ", juce::dontSendNotification);
 
+    //add scan progress label and cancel button, only enabled while scanning
+    addAndMakeVisible(scanStatusLabel);
+    scanStatusLabel.setJustificationType(juce::Justification::centred);
+    addAndMakeVisible(cancelScanButton);
+    cancelScanButton.addListener(this);
+    cancelScanButton.setEnabled(false);
+
+    //receive track metadata from the background scanner, and tempos from the analyser
+    scanner.addListener(this);
+    analyser.addListener(this);
+
+    //restore the library saved by the last session, then check in the background
+    //whether any of the files have changed since. Unchanged files are not opened.
+    database.load();
+    for (const LibraryDatabase::Entry& entry : database.getEntries())
+    {
+        bool wasAdded;
+        TrackStore::TrackId trackIndex = addTrack(entry.path, (int)entry.lengthInSeconds, wasAdded);
+        tracks.setDateAdded(trackIndex, entry.dateAdded);
+        tracks.setBpm(trackIndex, entry.bpm);
+        tracks.setFirstBeatSeconds(trackIndex, entry.firstBeatSeconds);
+        tracks.setKey(trackIndex, entry.key);
+        tracks.setAnalysed(trackIndex, entry.analysed);
+        LibraryScanner::Result previous = resultFromEntry(entry);
+        scanner.scanFile(trackIndex, File{ entry.path }, &previous);
+    }
+    //once every track has been checked, thumbnails of tracks no longer in the library can go
+    pruneThumbnailsAfterScan = !database.getEntries().empty();
+    applySearchFilter();
 }
 
 PlaylistComponent::~PlaylistComponent()
 {
+    scanner.removeListener(this);
+    analyser.removeListener(this);
 }
 
 
@@ -48,7 +106,9 @@ void PlaylistComponent::resized()
 
     //set position of search functionality
     searchLabel.setBounds(0, 0, colW, rowH);
-    searchBar.setBounds(colW, 0, colW * 5, rowH);
+    searchBar.setBounds(colW, 0, colW * 3, rowH);
+    scanStatusLabel.setBounds(colW * 4, 0, colW, rowH);
+    cancelScanButton.setBounds(colW * 5, 0, colW, rowH);
     //set position of table
     tableComponent.setBounds(0, rowH, getWidth(), rowH*7);
 
@@ -58,7 +118,7 @@ void PlaylistComponent::resized()
 //==============================================================================
 int PlaylistComponent::getNumRows()
 {
-    return interestedTitle.size(); // length of filtered vector
+    return filteredTracks.size(); // number of tracks matching the search
 }
 
 void PlaylistComponent::paintRowBackground(Graphics& g,
@@ -86,16 +146,56 @@ void PlaylistComponent::paintCell(Graphics& g,
     // Draw Track Title Name to first column
     if (columnId == 1)
     {
-        g.drawText(interestedTitle[rowNumber],
+        g.drawText(tracks.getTitle(filteredTracks[rowNumber]),
             1, rowNumber,
             width - 4, height,
             Justification::centredLeft,
             true);
     }
-    // Draw duration in seconds to second column
+    // Draw duration in seconds to second column, or the scan state if it is not known yet
     if (columnId == 2)
     {
-        g.drawText(std::to_string(interestedDuration[rowNumber]) + "s",
+        int trackDuration = tracks.getDuration(filteredTracks[rowNumber]);
+        std::string duration = std::to_string(trackDuration) + "s";
+        if (trackDuration == durationScanning)
+        {
+            duration = "scanning...";
+        }
+        if (trackDuration == durationUnreadable)
+        {
+            duration = "-";
+        }
+        g.drawText(duration,
+            1, rowNumber,
+            width - 4, height,
+            Justification::centredLeft,
+            true);
+    }
+    // Draw tempo to the BPM column, left empty until the track has been analysed
+    if (columnId == 5)
+    {
+        double bpm = tracks.getBpm(filteredTracks[rowNumber]);
+        g.drawText(bpm > 0 ? String(bpm, 1) : String("-"),
+            1, rowNumber,
+            width - 4, height,
+            Justification::centredLeft,
+            true);
+    }
+    // Draw musical key to the Key column, as its Camelot code and name
+    if (columnId == 6)
+    {
+        int key = tracks.getKey(filteredTracks[rowNumber]);
+        g.drawText(key >= 0 ? KeyDetector::getCamelotCode(key) + " " + KeyDetector::getKeyName(key) : String("-"),
+            1, rowNumber,
+            width - 4, height,
+            Justification::centredLeft,
+            true);
+    }
+    // Draw the date the track was added to the library
+    if (columnId == 7)
+    {
+        Time dateAdded(tracks.getDateAdded(filteredTracks[rowNumber]));
+        g.drawText(dateAdded.toMilliseconds() > 0 ? dateAdded.formatted("%Y-%m-%d") : String("-"),
             1, rowNumber,
             width - 4, height,
             Justification::centredLeft,
@@ -108,34 +208,41 @@ Component* PlaylistComponent::refreshComponentForCell(int rowNumber,
     bool isRowSelected,
     Component* existingComponentToUpdate)
 {
-    // Create buttons for each line in the 3rd column to add to the Left channel deck
-    if (columnId == 3)
+    // Create buttons for each line in the deck columns to add the track to that deck
+    if (columnId >= firstDeckColumnId)
     {
-        if (existingComponentToUpdate == nullptr)
+        AddToDeckButton* btn = static_cast<AddToDeckButton*>(existingComponentToUpdate);
+        if (btn == nullptr)
         {
-            TextButton* btn = new TextButton{ "Add to L" };
-            String id{ std::to_string(rowNumber) };
-            btn->setComponentID(id);
+            btn = new AddToDeckButton{ columnId - firstDeckColumnId };
             btn->addListener(this);
-            existingComponentToUpdate = btn;
             btn->setColour(TextButton::buttonColourId, juce::Colours::darkslategrey);
         }
+        //buttons are reused for other rows as the table scrolls or is filtered
+        btn->rowNumber = rowNumber;
+        existingComponentToUpdate = btn;
     }
-    // Create buttons for each line in the 3rd column to add to the Right channel deck
-    if (columnId == 4)
+    return existingComponentToUpdate;
+}
+
+
+void PlaylistComponent::sortOrderChanged(int newSortColumnId, bool isForwards)
+{
+    //map table columns to the columns of the sort order
+    TrackSortOrder::Column column = TrackSortOrder::unsorted;
+    switch (newSortColumnId)
     {
-        if (existingComponentToUpdate == nullptr)
-        {
-            TextButton* btn = new TextButton{ "Add to R" };
-            // add 1000 to id to allow buttons to be processed differently between channels
-            String id{ std::to_string(rowNumber + 1000) }; 
-            btn->setComponentID(id);
-            btn->addListener(this);
-            existingComponentToUpdate = btn;
-            btn->setColour(TextButton::buttonColourId, juce::Colours::darkslategrey);
-        }
+    case 1: column = TrackSortOrder::byTitle; break;
+    case 2: column = TrackSortOrder::byDuration; break;
+    case 5: column = TrackSortOrder::byBpm; break;
+    case 6: column = TrackSortOrder::byKey; break;
+    case 7: column = TrackSortOrder::byDateAdded; break;
+    default: break;
     }
-    return existingComponentToUpdate;
+
+    sortOrder.setColumn(column, isForwards);
+    applySearchFilter();
+    tableComponent.repaint();
 }
 
 
@@ -149,17 +256,22 @@ void PlaylistComponent::releaseResources(){}
 //==============================================================================
 void PlaylistComponent::buttonClicked(Button* button)
 {
-    //get id of button 
-    int id = std::stoi(button->getComponentID().toStdString()); 
-    //if id is less than 1000, it should be allocated to the left channel GUI player. 
-    if (id < 1000)
+    if (button == &cancelScanButton)
     {
-        addToChannelList(interestedFiles[id], 0);
+        scanner.cancelAll();
+        analyser.cancelAll();
+        //tracks left unchecked still have thumbnails worth keeping
+        pruneThumbnailsAfterScan = false;
+        return;
     }
-    //if id is 1000 of more, it should be allocated to the right chanel GUI player
-    else 
+
+    //queue the track in the button's row on the button's deck
+    if (AddToDeckButton* addButton = dynamic_cast<AddToDeckButton*>(button))
     {
-        addToChannelList(interestedFiles[id - 1000], 1);
+        if (addButton->rowNumber < (int)filteredTracks.size())
+        {
+            addToDeckList(tracks.getPath(filteredTracks[addButton->rowNumber]), addButton->deckIndex);
+        }
     }
 }
 
@@ -175,90 +287,255 @@ void PlaylistComponent::filesDropped(const StringArray& files, int x, int y)
     //perform if files have been dropped (mouse released with files) 
     for (String filename : files)
     {
-        //for each file URL, get filepath and file name 
-        std::string filepath = String(filename).toStdString();
-        std::size_t startFilePos = filepath.find_last_of("\\");
-        std::size_t startExtPos = filepath.find_last_of(".");
-        std::string extn = filepath.substr(startExtPos + 1, filepath.length() - startExtPos);
-        std::string file = filepath.substr(startFilePos + 1, filepath.length() - startFilePos - extn.size() - 2);
-
-        //update vectors for file details
-        inputFiles.push_back(filepath);
-        trackTitles.push_back(file);
-
-        //compute adudio length of the file and update vectors for file details 
-        getAudioLength(URL{ File{filepath} });
+        //add the track to the library, the duration is filled in once the file has been scanned.
+        //Files already in the library are not added twice
+        bool wasAdded;
+        TrackStore::TrackId trackIndex = addTrack(filename, durationScanning, wasAdded);
+        if (!wasAdded)
+        {
+            continue;
+        }
 
+        //compute audio length of the file in the background. 
+        //Tracks saved in the database were restored at startup, so new tracks always need reading
+        getAudioLength(trackIndex, File{ filename });
     }
-    //Initialise interested titles as the full list. 
-    //This will be updated when text is entered in the search bar
-    interestedTitle = trackTitles;
-    interestedFiles = inputFiles;
 
-    //update the music library table to include added files 
-    tableComponent.updateContent();
+    //show the added files straight away, respecting any text in the search bar
+    applySearchFilter();
 }
 
 
 //==============================================================================
 void PlaylistComponent::textEditorTextChanged(TextEditor& textEditor)
 {
-    //whenever the search box is modified, clear the vectors that will be used for the table 
-    interestedTitle.clear(); 
-    interestedDuration.clear();
-    interestedFiles.clear();
-
-    // start at position 0 of the original library list and increment until the last element of the list
-    int pos = 0;
-    for (std::string track : trackTitles)
-    {   
-        //check if the texts typed in the search box is a substring of the track title we are currently processing
-        if (track.find(searchBar.getText().toStdString()) != std::string::npos)
+    applySearchFilter();
+}
+
+
+//==============================================================================
+void PlaylistComponent::scanResultsReady(const std::vector<LibraryScanner::Result>& results)
+{
+    for (const LibraryScanner::Result& result : results)
+    {
+        //a cancelled scan keeps whatever duration was already known
+        if (result.cancelled)
+        {
+            if (tracks.getDuration(result.trackIndex) == durationScanning)
+            {
+                tracks.setDuration(result.trackIndex, durationUnreadable);
+            }
+            pruneThumbnailsAfterScan = false;
+            continue;
+        }
+
+        if (result.readable)
+        {
+            tracks.setDuration(result.trackIndex, (int)result.lengthInSeconds);
+            //have the waveform ready before the track is first loaded to a deck. The scan has already read the
+            //size and modification time the hash is made from, and a track with a thumbnail on disk is skipped
+            const File file = tracks.getFile(result.trackIndex);
+            const int64 hashCode = PcmFileCache::getTrackHash(file, result.fileSize, result.modificationTime);
+            thumbCache.generateInBackground(URL(file), hashCode);
+            libraryThumbnails.insert(hashCode);
+        }
+        else
+        {
+            tracks.setDuration(result.trackIndex, durationUnreadable);
+        }
+
+        //store newly read metadata. Analysis results of a modified file are no longer valid
+        if (result.readable && result.changed)
+        {
+            LibraryDatabase::Entry entry;
+            entry.path = CharPointer_UTF8(tracks.getPath(result.trackIndex));
+            entry.modificationTime = result.modificationTime;
+            entry.fileSize = result.fileSize;
+            entry.lengthInSeconds = result.lengthInSeconds;
+            entry.sampleRate = result.sampleRate;
+            entry.numChannels = result.numChannels;
+            entry.dateAdded = tracks.getDateAdded(result.trackIndex);
+            database.update(entry);
+
+            tracks.setBpm(result.trackIndex, 0.0);
+            tracks.setFirstBeatSeconds(result.trackIndex, 0.0);
+            tracks.setKey(result.trackIndex, -1);
+            tracks.setAnalysed(result.trackIndex, false);
+        }
+
+        //tracks that have not been analysed yet, or were modified, are analysed in the background
+        if (result.readable && !tracks.isAnalysed(result.trackIndex))
+        {
+            analyser.analyseFile(result.trackIndex, tracks.getFile(result.trackIndex));
+        }
+    }
+
+    //durations are shown in place while the scan runs, the rows stay where they are as searches only match titles.
+    //The order is rebuilt once, with the last batch, rather than every batch of a large library
+    if (scanner.isScanning())
+    {
+        tableComponent.repaint();
+        return;
+    }
+
+    //durations have changed, the sorted order has to be rebuilt
+    sortOrder.tracksChanged();
+
+    //refresh the table once for the whole scan
+    applySearchFilter();
+    tableComponent.repaint();
+}
+
+void PlaylistComponent::scanProgressChanged(int numCompleted, int numTotal)
+{
+    if (numCompleted < numTotal)
+    {
+        scanStatusLabel.setText("Scanning " + String(numCompleted) + "/" + String(numTotal),
+            juce::dontSendNotification);
+        cancelScanButton.setEnabled(true);
+    }
+    else
+    {
+        scanStatusLabel.setText("", juce::dontSendNotification);
+        cancelScanButton.setEnabled(false);
+
+        //scan finished, keep the database up to date in case the app does not exit cleanly
+        database.save();
+
+        //every track has been checked, so a thumbnail not in use is for a file that has changed,
+        //become unreadable, or was never in the library
+        if (pruneThumbnailsAfterScan)
         {
-            //if there is a match, push the item to the vector used for displaying values in the table
-            interestedTitle.push_back(trackTitles[pos]);
-            interestedDuration.push_back(trackDurations[pos]);
-            interestedFiles.push_back(inputFiles[pos]);
+            thumbCache.removeThumbnailsExcept(libraryThumbnails);
+            pruneThumbnailsAfterScan = false;
         }
-        ++pos; 
     }
-    //update the contents of the table after looping
-    tableComponent.updateContent();
 }
 
 
 //==============================================================================
-// Add music file to list of the respective Left/Right channel's playlist
-void PlaylistComponent::addToChannelList(std::string filepath, int channel)
+void PlaylistComponent::analysisResultsReady(const std::vector<TrackAnalyser::Result>& results)
 {
-    if (channel == 0) //left
+    for (const TrackAnalyser::Result& result : results)
     {
-        playListL.push_back(filepath);
+        //cancelled tracks are analysed again on the next scan
+        if (result.cancelled)
+        {
+            continue;
+        }
+
+        //tracks with no tempo or key found, or that could not be read, are not analysed again until they change
+        tracks.setBpm(result.trackIndex, result.bpm);
+        tracks.setFirstBeatSeconds(result.trackIndex, result.firstBeatSeconds);
+        tracks.setKey(result.trackIndex, result.key);
+        tracks.setAnalysed(result.trackIndex, true);
+
+        //the scan has stored the track's entry by now, add the analysis to it
+        if (const LibraryDatabase::Entry* existing = database.find(CharPointer_UTF8(tracks.getPath(result.trackIndex))))
+        {
+            LibraryDatabase::Entry entry = *existing;
+            entry.bpm = result.bpm;
+            entry.firstBeatSeconds = result.firstBeatSeconds;
+            entry.key = result.key;
+            entry.analysed = true;
+            database.update(entry);
+        }
     }
-    if (channel == 1) //right
+
+    //tempos and keys have changed, the sorted order has to be rebuilt
+    sortOrder.tracksChanged();
+
+    //refresh the table once for the whole batch
+    applySearchFilter();
+    tableComponent.repaint();
+}
+
+void PlaylistComponent::analysisProgressChanged(int numCompleted, int numTotal)
+{
+    //scan progress takes the label while both are running
+    if (scanner.isScanning())
+    {
+        return;
+    }
+
+    if (numCompleted < numTotal)
     {
-        playListR.push_back(filepath);
+        scanStatusLabel.setText("Analysing " + String(numCompleted) + "/" + String(numTotal),
+            juce::dontSendNotification);
+        cancelScanButton.setEnabled(true);
     }
+    else
+    {
+        scanStatusLabel.setText("", juce::dontSendNotification);
+        cancelScanButton.setEnabled(false);
+
+        //analysis finished, keep the database up to date in case the app does not exit cleanly
+        database.save();
+    }
+}
+
+
+//==============================================================================
+void PlaylistComponent::applySearchFilter()
+{
+    //whenever the search box or the library is modified, look up the rows matching the search text.
+    //The index narrows down the previous matches while the user keeps typing.
+    //Search rows are track ids, as titles are indexed in the order tracks are added.
+    //The matches are then put in the order of the sorted column.
+    sortOrder.apply(tracks, searchIndex.search(searchBar.getText()), filteredTracks);
+
+    //update the contents of the table
+    tableComponent.updateContent();
 }
 
-// get audio length metadata
-void PlaylistComponent::getAudioLength(URL audioURL)
+
+//==============================================================================
+// Add music file to the up next list of the respective deck
+void PlaylistComponent::addToDeckList(std::string filepath, int deckIndex)
 {
-    double trackLen = 0.0;
+    upNextLists[(size_t)deckIndex].push_back(filepath);
+}
 
-    auto* reader = formatManager.createReaderFor(audioURL.createInputStream(false));
+std::vector<std::string>& PlaylistComponent::getUpNext(int deckIndex)
+{
+    return upNextLists[(size_t)deckIndex];
+}
 
-    if (reader != nullptr) // good file!
+bool PlaylistComponent::getBeatGrid(const String& path, double& bpm, double& firstBeatSeconds) const
+{
+    TrackStore::TrackId id = tracks.findTrack(path);
+    if (id < 0 || tracks.getBpm(id) <= 0)
     {
-        std::unique_ptr<AudioFormatReaderSource> newSource(new AudioFormatReaderSource(reader,
-            true));
-        transportSource.setSource(newSource.get(), 0, nullptr, reader->sampleRate);
-        readerSource.reset(newSource.release());
-        double trackLen = transportSource.getLengthInSeconds(); // get length of audio
-        trackDurations.push_back(trackLen); // add audio length to vector
+        return false;
     }
+    bpm = tracks.getBpm(id);
+    firstBeatSeconds = tracks.getFirstBeatSeconds(id);
+    return true;
+}
 
-    //Initialise interested durations as the full list. 
-    //This will be updated when text is entered in the search bar
-    interestedDuration = trackDurations;
+// Add track to the library and return its id
+TrackStore::TrackId PlaylistComponent::addTrack(const String& path, int duration, bool& wasAdded)
+{
+    //get file name from filepath
+    std::string filepath = path.toStdString();
+    std::size_t startFilePos = filepath.find_last_of("\\");
+    std::size_t startExtPos = filepath.find_last_of(".");
+    std::string extn = filepath.substr(startExtPos + 1, filepath.length() - startExtPos);
+    std::string file = filepath.substr(startFilePos + 1, filepath.length() - startFilePos - extn.size() - 2);
+
+    //update the track store, and index the title of new tracks for searching
+    TrackStore::TrackId id = tracks.addTrack(path, file, duration, wasAdded);
+    if (wasAdded)
+    {
+        searchIndex.addTitle(tracks.getTitle(id));
+        sortOrder.tracksChanged();
+    }
+
+    return id;
+}
+
+// get audio length metadata, read on the scanner's worker threads
+void PlaylistComponent::getAudioLength(int trackIndex, const File& file)
+{
+    scanner.scanFile(trackIndex, file);
 }
\ No newline at end of file
@@ -12,6 +12,14 @@
 #include <JuceHeader.h>
 #include <vector>
 #include <string>
+#include <unordered_set>
+#include "LibraryScanner.h"
+#include "TrackAnalyser.h"
+#include "LibraryDatabase.h"
+#include "LibrarySearchIndex.h"
+#include "TrackStore.h"
+#include "TrackSortOrder.h"
+#include "DiskThumbnailCache.h"
 
 //===============================================================================
 /*
@@ -23,12 +31,15 @@ class PlaylistComponent : public juce::Component,
     public AudioSource,
     public Button::Listener,
     public FileDragAndDropTarget,
-    public TextEditor::Listener
+    public TextEditor::Listener,
+    public LibraryScanner::Listener,
+    public TrackAnalyser::Listener
 {
 public:
 
     //==============================================================================
-    PlaylistComponent(AudioFormatManager& formatManager);
+    /**The table has a button per deck to queue tracks on it, for numDecks decks*/
+    PlaylistComponent(AudioFormatManager& formatManager, DiskThumbnailCache& thumbCache, PcmFileCache& pcmCache, int numDecks);
     ~PlaylistComponent() override;
 
 
@@ -64,6 +75,9 @@ public:
         int columnId,
         bool isRowSelected,
         Component* existingComponentToUpdate) override;
+    /**Override of TableListBoxModel function. 
+    Called when the user clicks a column header, to sort the library by that column*/
+    void sortOrderChanged(int newSortColumnId, bool isForwards) override;
 
 
     //==============================================================================
@@ -99,37 +113,98 @@ public:
 
 
     //==============================================================================
-    /**Vector of songs to be added to the Left Channel Player, utilised by DeckGUI*/
-    std::vector<std::string> playListL;
-    /**Vector of songs to be added to the Right Channel Player, utilised by DeckGUI*/
-    std::vector<std::string> playListR;
+    /**Override of LibraryScanner::Listener pure virtual.
+    Fills in the durations of scanned tracks and refreshes the table once per batch*/
+    void scanResultsReady(const std::vector<LibraryScanner::Result>& results) override;
+    /**Override of LibraryScanner::Listener pure virtual.
+    Updates the scan status shown next to the search bar*/
+    void scanProgressChanged(int numCompleted, int numTotal) override;
+
+
+    //==============================================================================
+    /**Override of TrackAnalyser::Listener pure virtual.
+    Stores the tempo, beat grid and key of analysed tracks and refreshes the table once per batch*/
+    void analysisResultsReady(const std::vector<TrackAnalyser::Result>& results) override;
+    /**Override of TrackAnalyser::Listener pure virtual.
+    Shows analysis progress next to the search bar while no scan is running*/
+    void analysisProgressChanged(int numCompleted, int numTotal) override;
+
+
+    //==============================================================================
+    /**Vector of songs queued to be played next on the deck at deckIndex, utilised by DeckGUI*/
+    std::vector<std::string>& getUpNext(int deckIndex);
+    /**Tempo and first downbeat of a library track, for syncing decks.
+    Returns false, leaving bpm at 0, if the track is not in the library or has not been analysed*/
+    bool getBeatGrid(const String& path, double& bpm, double& firstBeatSeconds) const;
 
 
 private:
 
+    //==============================================================================
+    /**Button in a deck's column of the table. The row is updated whenever the table reuses the button*/
+    class AddToDeckButton : public TextButton
+    {
+    public:
+        AddToDeckButton(int _deckIndex) : TextButton("Add to " + String(_deckIndex + 1)), deckIndex(_deckIndex) {}
+
+        const int deckIndex;
+        int rowNumber = 0;
+    };
+
+    //column of the first deck's buttons, each deck after it has the next column
+    enum { firstDeckColumnId = 100 };
+
     AudioFormatManager& formatManager;
-    std::unique_ptr<AudioFormatReaderSource> readerSource;
-    AudioTransportSource transportSource;
+    DiskThumbnailCache& thumbCache;
+    PcmFileCache& pcmCache;
+
+    //library saved between launches, so unchanged files are never read again
+    LibraryDatabase database;
+
+    //reads track metadata in the background
+    LibraryScanner scanner{ formatManager };
+
+    //hashes of the readable tracks' thumbnails, and whether the startup scan is still set to prune the rest
+    std::unordered_set<int64> libraryThumbnails;
+    bool pruneThumbnailsAfterScan = false;
+
+    //finds the tempo, beat grid and key of readable tracks in the background
+    TrackAnalyser analyser{ formatManager, pcmCache };
 
     //Playlist displayed as a table list
     TableListBox tableComponent; 
 
-    //vectors to store music file metadata
-    std::vector<std::string> inputFiles;
-    std::vector<std::string> interestedFiles;
-    std::vector<std::string> trackTitles; 
-    std::vector<std::string> interestedTitle;
-    std::vector<int> trackDurations;
-    std::vector<int> interestedDuration;
+    //music file metadata, one entry per track in the library
+    TrackStore tracks;
+
+    //index of track titles for searching, and the tracks matching the search bar.
+    //Rows of the table are positions in filteredTracks
+    LibrarySearchIndex searchIndex;
+    std::vector<TrackStore::TrackId> filteredTracks;
+
+    //order of the tracks for the column selected in the table header
+    TrackSortOrder sortOrder;
+
+    //placeholder durations shown while a track has not been read yet, or could not be read
+    enum { durationScanning = -1, durationUnreadable = -2 };
 
     // Search bar and label to allow for searching functionality 
     TextEditor searchBar;
     Label searchLabel;
 
+    // Progress of the background scan or analysis and button to cancel it
+    Label scanStatusLabel;
+    TextButton cancelScanButton{ "Cancel Scan" };
+
+    //tracks queued on each deck
+    std::vector<std::vector<std::string>> upNextLists;
+
     //==============================================================================
     //user defined variables to process data
-    void addToChannelList(std::string filepath, int channel);
-    void getAudioLength(URL audioURL);
+    void addToDeckList(std::string filepath, int deckIndex);
+    TrackStore::TrackId addTrack(const String& path, int duration, bool& wasAdded);
+    void getAudioLength(int trackIndex, const File& file);
+    void applySearchFilter();
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PlaylistComponent)
 };
@@ -0,0 +1,294 @@
+/*
+  ==============================================================================
+    PolyphaseResamplingAudioSource.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "PolyphaseResamplingAudioSource.h"
+#include <cmath>
+#include <cstring>
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#elif JUCE_ARM && defined(__ARM_NEON)
+ #include <arm_neon.h>
+#endif
+
+namespace
+{
+    //taps at normal speed, phases in the table, passband as a fraction of Nyquist and
+    //Kaiser window shape for each quality
+    const int unityTaps[] = { 8, 16, 32 };
+    const int numPhasesForQuality[] = { 64, 128, 256 };
+    const double passband[] = { 0.85, 0.9, 0.95 };
+    const double kaiserBeta[] = { 5.0, 7.0, 9.0 };
+
+    //the cutoff is lowered in these steps as the ratio rises, up to the fastest ratio supported
+    const double ratioSteps[] = { 1.0, 1.5, 2.0, 3.0, 4.0 };
+    const int numRatioSteps = 5;
+    const double maxRatio = 4.0;
+
+    /**Zeroth order modified Bessel function of the first kind, for the Kaiser window*/
+    double besselI0(double x)
+    {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 32; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    /**Sum of samples times taps, where numTaps is a multiple of 8.
+    Uses AVX and FMA when the build enables them, otherwise SSE or NEON*/
+    float dotProduct(const float* samples, const float* taps, int numTaps)
+    {
+       #if JUCE_INTEL && defined(__AVX__)
+        __m256 sum = _mm256_setzero_ps();
+        for (int i = 0; i < numTaps; i += 8)
+        {
+          #if defined(__FMA__)
+            sum = _mm256_fmadd_ps(_mm256_loadu_ps(samples + i), _mm256_loadu_ps(taps + i), sum);
+          #else
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(samples + i), _mm256_loadu_ps(taps + i)));
+          #endif
+        }
+        __m128 quad = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+        quad = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+        quad = _mm_add_ss(quad, _mm_shuffle_ps(quad, quad, 1));
+        return _mm_cvtss_f32(quad);
+       #elif JUCE_INTEL
+        __m128 sum0 = _mm_setzero_ps();
+        __m128 sum1 = _mm_setzero_ps();
+        for (int i = 0; i < numTaps; i += 8)
+        {
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(samples + i), _mm_loadu_ps(taps + i)));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(samples + i + 4), _mm_loadu_ps(taps + i + 4)));
+        }
+        __m128 quad = _mm_add_ps(sum0, sum1);
+        quad = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+        quad = _mm_add_ss(quad, _mm_shuffle_ps(quad, quad, 1));
+        return _mm_cvtss_f32(quad);
+       #elif JUCE_ARM && defined(__ARM_NEON)
+        float32x4_t sum0 = vdupq_n_f32(0.0f);
+        float32x4_t sum1 = vdupq_n_f32(0.0f);
+        for (int i = 0; i < numTaps; i += 8)
+        {
+            sum0 = vmlaq_f32(sum0, vld1q_f32(samples + i), vld1q_f32(taps + i));
+            sum1 = vmlaq_f32(sum1, vld1q_f32(samples + i + 4), vld1q_f32(taps + i + 4));
+        }
+        const float32x4_t quad = vaddq_f32(sum0, sum1);
+        return vgetq_lane_f32(quad, 0) + vgetq_lane_f32(quad, 1) + vgetq_lane_f32(quad, 2) + vgetq_lane_f32(quad, 3);
+       #else
+        float sum = 0.0f;
+        for (int i = 0; i < numTaps; ++i)
+        {
+            sum += samples[i] * taps[i];
+        }
+        return sum;
+       #endif
+    }
+}
+
+PolyphaseResamplingAudioSource::PolyphaseResamplingAudioSource(AudioSource* _input, int _numChannels)
+    : input(_input),
+      numChannels(_numChannels)
+{
+    jassert(input != nullptr);
+}
+
+PolyphaseResamplingAudioSource::~PolyphaseResamplingAudioSource()
+{}
+
+
+//==============================================================================
+void PolyphaseResamplingAudioSource::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    if (tables.isEmpty())
+    {
+        for (int q = draft; q <= high; ++q)
+        {
+            for (int step = 0; step < numRatioSteps; ++step)
+            {
+                //more taps as the cutoff falls keeps the transition band the same width in output samples
+                const int numTaps = 8 * (int)std::ceil(unityTaps[q] * ratioSteps[step] / 8.0);
+                FilterTable* table = tables.add(new FilterTable());
+                buildTable(*table, numTaps, numPhasesForQuality[q], passband[q] / ratioSteps[step], kaiserBeta[q]);
+            }
+        }
+    }
+
+    //enough history for the longest filter, so changing table never reads before the buffer
+    historyLength = tables.getLast()->numTaps / 2;
+    inputCapacity = historyLength * 2 + (int)std::ceil(samplesPerBlockExpected * maxRatio) + 8;
+    inputBuffer.setSize(numChannels, inputCapacity);
+
+    input->prepareToPlay(roundToInt(samplesPerBlockExpected * maxRatio), sampleRate);
+    reset();
+}
+
+void PolyphaseResamplingAudioSource::releaseResources()
+{
+    input->releaseResources();
+}
+
+void PolyphaseResamplingAudioSource::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
+{
+    if (tables.isEmpty())
+    {
+        bufferToFill.clearActiveBufferRegion();
+        return;
+    }
+
+    const FilterTable& table = getCurrentTable();
+    const int halfTaps = table.numTaps / 2;
+
+    int done = 0;
+    while (done < bufferToFill.numSamples)
+    {
+        //as many output samples as the filter can reach within the input buffer
+        int numThisTime = bufferToFill.numSamples - done;
+        if (ratio > 0.0)
+        {
+            numThisTime = jmin(numThisTime, (int)((inputCapacity - halfTaps - 1 - position) / ratio) + 1);
+        }
+        fillInput((int)(position + (numThisTime - 1) * ratio) + halfTaps + 1);
+
+        for (int i = 0; i < numThisTime; ++i)
+        {
+            const int readPosition = (int)position;
+            const double phasePosition = (position - readPosition) * table.numPhases;
+            const int phase = (int)phasePosition;
+            const float phaseFraction = (float)(phasePosition - phase);
+
+            const float* taps = table.getPhase(phase);
+            const float* nextTaps = table.getPhase(phase + 1);
+            const int firstTap = readPosition - (halfTaps - 1);
+
+            for (int channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
+            {
+                const float* samples = inputBuffer.getReadPointer(jmin(channel, numChannels - 1), firstTap);
+                const float sample = dotProduct(samples, taps, table.numTaps);
+                const float nextSample = dotProduct(samples, nextTaps, table.numTaps);
+                bufferToFill.buffer->setSample(channel, bufferToFill.startSample + done + i,
+                    sample + (nextSample - sample) * phaseFraction);
+            }
+            position += ratio;
+        }
+
+        done += numThisTime;
+        discardInput();
+    }
+}
+
+
+//==============================================================================
+void PolyphaseResamplingAudioSource::setResamplingRatio(double samplesInPerOutputSample)
+{
+    ratio = jlimit(0.0, maxRatio, samplesInPerOutputSample);
+}
+
+void PolyphaseResamplingAudioSource::setQuality(Quality newQuality)
+{
+    quality = newQuality;
+}
+
+PolyphaseResamplingAudioSource::Quality PolyphaseResamplingAudioSource::getQuality() const
+{
+    return quality;
+}
+
+int PolyphaseResamplingAudioSource::getLatencySamples() const
+{
+    return tables.isEmpty() ? 0 : getCurrentTable().numTaps / 2;
+}
+
+void PolyphaseResamplingAudioSource::reset()
+{
+    //start with silence before the first sample, so the filter has history to read
+    inputBuffer.clear();
+    inputFill = historyLength;
+    position = historyLength;
+}
+
+
+//==============================================================================
+void PolyphaseResamplingAudioSource::buildTable(FilterTable& table, int numTaps, int numPhases, double cutoff, double beta)
+{
+    table.numTaps = numTaps;
+    table.numPhases = numPhases;
+    table.coefficients.allocate((size_t)(numTaps * (numPhases + 1)), true);
+
+    const int halfTaps = numTaps / 2;
+    const double windowScale = 1.0 / besselI0(beta);
+
+    for (int phase = 0; phase <= numPhases; ++phase)
+    {
+        //tap j is applied to the input halfTaps - 1 - j samples before the read position, less the phase
+        float* row = table.coefficients + phase * numTaps;
+        const double fraction = (double)phase / numPhases;
+        double sum = 0.0;
+
+        for (int j = 0; j < numTaps; ++j)
+        {
+            const double x = j - (halfTaps - 1) - fraction;
+            const double t = x / halfTaps;
+            const double window = std::abs(t) < 1.0 ? besselI0(beta * std::sqrt(1.0 - t * t)) * windowScale : 0.0;
+            const double arg = MathConstants<double>::pi * cutoff * x;
+            const double sinc = std::abs(arg) < 1.0e-9 ? 1.0 : std::sin(arg) / arg;
+
+            row[j] = (float)(cutoff * sinc * window);
+            sum += row[j];
+        }
+
+        //unity gain at DC for every phase, so a steady level does not ripple with the phase
+        for (int j = 0; j < numTaps; ++j)
+        {
+            row[j] = (float)(row[j] / sum);
+        }
+    }
+}
+
+const PolyphaseResamplingAudioSource::FilterTable& PolyphaseResamplingAudioSource::getCurrentTable() const
+{
+    int step = 0;
+    while (step < numRatioSteps - 1 && ratioSteps[step] < ratio)
+    {
+        ++step;
+    }
+    return *tables.getUnchecked(quality * numRatioSteps + step);
+}
+
+void PolyphaseResamplingAudioSource::fillInput(int numRequired)
+{
+    jassert(numRequired <= inputCapacity);
+    numRequired = jmin(numRequired, inputCapacity);
+
+    if (inputFill < numRequired)
+    {
+        AudioSourceChannelInfo info(&inputBuffer, inputFill, numRequired - inputFill);
+        input->getNextAudioBlock(info);
+        inputFill = numRequired;
+    }
+}
+
+void PolyphaseResamplingAudioSource::discardInput()
+{
+    const int numToDiscard = jlimit(0, inputFill, (int)position - historyLength);
+    if (numToDiscard == 0)
+    {
+        return;
+    }
+
+    const int numLeft = inputFill - numToDiscard;
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        float* samples = inputBuffer.getWritePointer(channel);
+        std::memmove(samples, samples + numToDiscard, sizeof(float) * (size_t)numLeft);
+    }
+    inputFill = numLeft;
+    position -= numToDiscard;
+}
@@ -0,0 +1,92 @@
+/*
+  ==============================================================================
+    PolyphaseResamplingAudioSource.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//===============================================================================
+/*
+    Plays its input at a variable speed through a band-limited windowed-sinc filter.
+    The filter is stored as a table of phases, each a short run of taps, and output samples
+    between two phases are interpolated from both. When reading faster than real time the
+    cutoff is lowered in steps so the speed-up does not alias.
+    Every table is built in prepareToPlay, so changing speed or quality never allocates.
+*/
+class PolyphaseResamplingAudioSource : public AudioSource
+{
+public:
+
+    /**Longer filters roll off more steeply and reject more aliasing, at the cost of CPU*/
+    enum Quality
+    {
+        draft,   //8 taps at normal speed
+        normal,  //16 taps
+        high     //32 taps
+    };
+
+    /**The input is not owned, and is read at the resampling ratio times the output rate*/
+    PolyphaseResamplingAudioSource(AudioSource* input, int numChannels = 2);
+    ~PolyphaseResamplingAudioSource() override;
+
+    //==============================================================================
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override;
+
+    //==============================================================================
+    /**Set the number of input samples read per output sample, where 2 plays twice as fast. Called from the audio thread*/
+    void setResamplingRatio(double samplesInPerOutputSample);
+    /**Set the filter length. Called from the audio thread*/
+    void setQuality(Quality newQuality);
+    Quality getQuality() const;
+    /**Number of input samples read ahead of the one being played, for the current ratio and quality*/
+    int getLatencySamples() const;
+
+    /**Drop the input buffered so far, after the input has been moved to a new position*/
+    void reset();
+
+private:
+    //==============================================================================
+    /**Filter for one quality at one cutoff. Each phase is a row of numTaps coefficients,
+    with one extra phase so the row after the last one can always be read*/
+    struct FilterTable
+    {
+        int numTaps = 0;
+        int numPhases = 0;
+        HeapBlock<float> coefficients;
+
+        const float* getPhase(int phase) const { return coefficients + phase * numTaps; }
+    };
+
+    /**Fill a table with a Kaiser-windowed sinc, cut off at the given fraction of the output Nyquist*/
+    static void buildTable(FilterTable& table, int numTaps, int numPhases, double cutoff, double beta);
+    /**Table for the current quality with the highest cutoff that does not alias at the current ratio*/
+    const FilterTable& getCurrentTable() const;
+    /**Read from the input until the buffer holds numRequired samples*/
+    void fillInput(int numRequired);
+    /**Drop input before the filter's reach from the current position*/
+    void discardInput();
+
+    AudioSource* input;
+    const int numChannels;
+
+    //a table for every quality and cutoff step, chosen by the ratio
+    OwnedArray<FilterTable> tables;
+    Quality quality = normal;
+    double ratio = 1.0;
+
+    //input read but not yet used. Position is where the next output sample is read from,
+    //with at least half a filter's history before it
+    AudioBuffer<float> inputBuffer;
+    int historyLength = 0;
+    int inputCapacity = 0;
+    int inputFill = 0;
+    double position = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PolyphaseResamplingAudioSource)
+};
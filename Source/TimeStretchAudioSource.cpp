@@ -0,0 +1,269 @@
+/*
+  ==============================================================================
+    TimeStretchAudioSource.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "TimeStretchAudioSource.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    //frame length and search radius in milliseconds for each quality
+    const double frameMs[] = { 20.0, 40.0, 80.0 };
+    const double searchMs[] = { 5.0, 10.0, 15.0 };
+
+    //tempo range the input buffer is sized for
+    const double minTempo = 0.25;
+    const double maxTempo = 4.0;
+}
+
+TimeStretchAudioSource::TimeStretchAudioSource(AudioSource* _input, int _numChannels)
+    : input(_input),
+      numChannels(_numChannels)
+{
+    jassert(input != nullptr);
+}
+
+TimeStretchAudioSource::~TimeStretchAudioSource()
+{}
+
+
+//==============================================================================
+void TimeStretchAudioSource::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    for (int q = draft; q <= high; ++q)
+    {
+        Settings& s = settings[q];
+        s.frameSize = 2 * jmax(64, roundToInt(frameMs[q] * sampleRate / 2000.0));
+        s.searchRadius = jmax(16, roundToInt(searchMs[q] * sampleRate / 1000.0));
+        s.window.allocate((size_t)s.frameSize, false);
+        for (int i = 0; i < s.frameSize; ++i)
+        {
+            s.window[i] = 0.5f - 0.5f * std::cos(MathConstants<float>::twoPi * i / s.frameSize);
+        }
+    }
+
+    //enough for the longest frame and search at the fastest tempo
+    const int maxFrameSize = settings[high].frameSize;
+    inputCapacity = 8 * maxFrameSize;
+    inputBuffer.setSize(numChannels, inputCapacity);
+    monoInput.allocate((size_t)inputCapacity, true);
+    overlapBuffer.setSize(numChannels, maxFrameSize);
+    outputBuffer.setSize(numChannels, maxFrameSize / 2);
+
+    input->prepareToPlay(samplesPerBlockExpected * 2, sampleRate);
+    reset();
+}
+
+void TimeStretchAudioSource::releaseResources()
+{
+    input->releaseResources();
+}
+
+void TimeStretchAudioSource::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
+{
+    int done = 0;
+    while (done < bufferToFill.numSamples)
+    {
+        if (outputFill == 0 && !processFrame())
+        {
+            bufferToFill.buffer->clear(bufferToFill.startSample + done, bufferToFill.numSamples - done);
+            return;
+        }
+
+        const int numToCopy = jmin(outputFill, bufferToFill.numSamples - done);
+        for (int channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
+        {
+            bufferToFill.buffer->copyFrom(channel,
+                bufferToFill.startSample + done,
+                outputBuffer,
+                jmin(channel, numChannels - 1),
+                0,
+                numToCopy);
+        }
+
+        //keep the rest of the hop for the next block
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            float* samples = outputBuffer.getWritePointer(channel);
+            std::memmove(samples, samples + numToCopy, sizeof(float) * (size_t)(outputFill - numToCopy));
+        }
+        outputFill -= numToCopy;
+        done += numToCopy;
+    }
+}
+
+
+//==============================================================================
+void TimeStretchAudioSource::setTempo(double ratio)
+{
+    tempo = jlimit(minTempo, maxTempo, ratio);
+}
+
+void TimeStretchAudioSource::setQuality(Quality newQuality)
+{
+    if (newQuality != quality)
+    {
+        quality = newQuality;
+        reset();
+    }
+}
+
+TimeStretchAudioSource::Quality TimeStretchAudioSource::getQuality() const
+{
+    return quality;
+}
+
+int TimeStretchAudioSource::getLatencySamples() const
+{
+    //a frame of output is held back, which covers a frame's worth of the input at the tempo it is read
+    return roundToInt(settings[quality].frameSize * tempo);
+}
+
+void TimeStretchAudioSource::reset()
+{
+    inputFill = 0;
+    outputFill = 0;
+    analysisPosition = 0.0;
+    previousStart = 0;
+    hasPreviousFrame = false;
+    overlapBuffer.clear();
+}
+
+
+//==============================================================================
+bool TimeStretchAudioSource::processFrame()
+{
+    const Settings& s = settings[quality];
+    const int hop = s.frameSize / 2;
+    const int nominalStart = roundToInt(analysisPosition);
+
+    if (s.frameSize == 0 || !fillInput(nominalStart + s.searchRadius + s.frameSize))
+    {
+        return false;
+    }
+
+    //the first frame after a reset has nothing to line up with
+    const int start = hasPreviousFrame ? findBestStart(nominalStart) : jmax(0, nominalStart);
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        float* overlap = overlapBuffer.getWritePointer(channel);
+        FloatVectorOperations::addWithMultiply(overlap, inputBuffer.getReadPointer(channel, start), s.window, s.frameSize);
+
+        //the first hop has had every frame that overlaps it added, so it is finished
+        FloatVectorOperations::copy(outputBuffer.getWritePointer(channel), overlap, hop);
+        std::memmove(overlap, overlap + hop, sizeof(float) * (size_t)(s.frameSize - hop));
+        FloatVectorOperations::clear(overlap + s.frameSize - hop, hop);
+    }
+    outputFill = hop;
+
+    previousStart = start;
+    hasPreviousFrame = true;
+    analysisPosition += hop * tempo;
+
+    //the next search starts no earlier than this, and the next comparison reads from the end of this frame's first hop
+    discardInput(jmin(roundToInt(analysisPosition) - s.searchRadius, previousStart + hop));
+    return true;
+}
+
+bool TimeStretchAudioSource::fillInput(int numRequired)
+{
+    if (numRequired > inputCapacity)
+    {
+        jassertfalse;
+        return false;
+    }
+
+    if (inputFill < numRequired)
+    {
+        const int numToRead = numRequired - inputFill;
+        AudioSourceChannelInfo info(&inputBuffer, inputFill, numToRead);
+        input->getNextAudioBlock(info);
+
+        //mono mix used by the search
+        const float scale = 1.0f / numChannels;
+        FloatVectorOperations::copyWithMultiply(monoInput + inputFill, inputBuffer.getReadPointer(0, inputFill), scale, numToRead);
+        for (int channel = 1; channel < numChannels; ++channel)
+        {
+            FloatVectorOperations::addWithMultiply(monoInput + inputFill, inputBuffer.getReadPointer(channel, inputFill), scale, numToRead);
+        }
+        inputFill = numRequired;
+    }
+    return true;
+}
+
+int TimeStretchAudioSource::findBestStart(int nominalStart) const
+{
+    const Settings& s = settings[quality];
+    const int overlapLength = s.frameSize / 2;
+    const int lowest = jmax(0, nominalStart - s.searchRadius);
+    const int highest = nominalStart + s.searchRadius;
+
+    //coarse pass over at most 33 positions, then every position around the best of them
+    const int step = jmax(1, s.searchRadius / 16);
+    int best = jlimit(lowest, highest, nominalStart);
+    float bestScore = similarity(best, overlapLength);
+
+    for (int start = lowest; start <= highest; start += step)
+    {
+        const float score = similarity(start, overlapLength);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            best = start;
+        }
+    }
+
+    const int coarseBest = best;
+    for (int start = jmax(lowest, coarseBest - step + 1); start <= jmin(highest, coarseBest + step - 1); ++start)
+    {
+        const float score = similarity(start, overlapLength);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            best = start;
+        }
+    }
+    return best;
+}
+
+float TimeStretchAudioSource::similarity(int start, int overlapLength) const
+{
+    //natural continuation of the previous frame
+    const float* reference = monoInput + previousStart + settings[quality].frameSize / 2;
+    const float* candidate = monoInput + start;
+
+    float product = 0.0f;
+    float energy = 0.0f;
+    for (int i = 0; i < overlapLength; ++i)
+    {
+        product += reference[i] * candidate[i];
+        energy += candidate[i] * candidate[i];
+    }
+    return product / std::sqrt(energy + 1.0e-9f);
+}
+
+void TimeStretchAudioSource::discardInput(int numSamples)
+{
+    numSamples = jlimit(0, inputFill, numSamples);
+    if (numSamples == 0)
+    {
+        return;
+    }
+
+    const int numLeft = inputFill - numSamples;
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        float* samples = inputBuffer.getWritePointer(channel);
+        std::memmove(samples, samples + numSamples, sizeof(float) * (size_t)numLeft);
+    }
+    std::memmove(monoInput.get(), monoInput + numSamples, sizeof(float) * (size_t)numLeft);
+
+    inputFill = numLeft;
+    analysisPosition -= numSamples;
+    previousStart -= numSamples;
+}
@@ -0,0 +1,100 @@
+/*
+  ==============================================================================
+    TimeStretchAudioSource.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//===============================================================================
+/*
+    Changes the tempo of its input without changing the pitch, using WSOLA: overlapping
+    windowed frames are taken from the input at the new tempo, each shifted within a small
+    search range to the position that best lines up with the frame before it.
+    The search is coarse then fine, so the work per output sample is bounded whatever the audio.
+    All buffers are allocated in prepareToPlay, nothing is allocated while playing.
+*/
+class TimeStretchAudioSource : public AudioSource
+{
+public:
+
+    /**Longer frames sound smoother on sustained material, at the cost of latency and CPU*/
+    enum Quality
+    {
+        draft,   //20 ms frames
+        normal,  //40 ms frames
+        high     //80 ms frames
+    };
+
+    /**The input is not owned, and is read at the tempo ratio times the output rate*/
+    TimeStretchAudioSource(AudioSource* input, int numChannels = 2);
+    ~TimeStretchAudioSource() override;
+
+    //==============================================================================
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override;
+
+    //==============================================================================
+    /**Set the ratio of input read to output played, where 2 plays twice as fast. Called from the audio thread*/
+    void setTempo(double ratio);
+    /**Set the frame size. Drops the audio buffered so far. Called from the audio thread*/
+    void setQuality(Quality newQuality);
+    Quality getQuality() const;
+    /**Number of input samples read ahead of the one being played, about a frame at the current tempo and quality*/
+    int getLatencySamples() const;
+
+    /**Drop the audio buffered so far, after the input has been moved to a new position*/
+    void reset();
+
+private:
+    //==============================================================================
+    struct Settings
+    {
+        int frameSize = 0;
+        int searchRadius = 0;
+        //periodic Hann window, which sums to one at half-frame overlap
+        HeapBlock<float> window;
+    };
+
+    /**Take one frame from the input and overlap-add it to the output. Returns false if the input
+    buffer cannot hold the frame*/
+    bool processFrame();
+    /**Read from the input until the buffer holds numRequired samples*/
+    bool fillInput(int numRequired);
+    /**Start of the frame near nominalStart that best continues the previous frame*/
+    int findBestStart(int nominalStart) const;
+    /**Normalised correlation of the frame at start with the continuation of the previous frame*/
+    float similarity(int start, int overlapLength) const;
+    /**Drop input that no later frame can use*/
+    void discardInput(int numSamples);
+
+    AudioSource* input;
+    const int numChannels;
+
+    Settings settings[3];
+    Quality quality = normal;
+    double tempo = 1.0;
+
+    //input read but not yet used, with a mono mix for the search
+    AudioBuffer<float> inputBuffer;
+    HeapBlock<float> monoInput;
+    int inputCapacity = 0;
+    int inputFill = 0;
+
+    //where the next frame would start without searching, and where the last one did start.
+    //The previous start can be before the buffer, only the part after its first hop is kept
+    double analysisPosition = 0.0;
+    int previousStart = 0;
+    bool hasPreviousFrame = false;
+
+    //frames being overlap-added, and finished output waiting to be played
+    AudioBuffer<float> overlapBuffer;
+    AudioBuffer<float> outputBuffer;
+    int outputFill = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TimeStretchAudioSource)
+};
@@ -0,0 +1,219 @@
+/*
+  ==============================================================================
+
+    TrackAnalyser.cpp
+    Author:  Shamie
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "TrackAnalyser.h"
+#include "BeatDetector.h"
+#include "KeyDetector.h"
+
+//==============================================================================
+/*
+    Decodes one track a chunk at a time, mixed to mono, and feeds it to the detectors.
+*/
+class TrackAnalyser::AnalysisJob : public ThreadPoolJob
+{
+public:
+    AnalysisJob(TrackAnalyser& _owner, int _trackIndex, const File& _file)
+        : ThreadPoolJob("TrackAnalyser::AnalysisJob"),
+          owner(_owner),
+          trackIndex(_trackIndex),
+          file(_file)
+    {}
+
+    JobStatus runJob() override
+    {
+        Result result;
+        result.trackIndex = trackIndex;
+        analyse(result);
+        owner.addResult(result);
+        return jobHasFinished;
+    }
+
+private:
+    void analyse(Result& result)
+    {
+        //the cached PCM file is mapped, so reading it costs no decoding
+        const URL audioURL(file);
+        std::unique_ptr<AudioFormatReader> reader(owner.pcmCache.createMappedReader(audioURL));
+        if (reader == nullptr)
+        {
+            reader.reset(owner.formatManager.createReaderFor(file));
+        }
+        if (reader == nullptr || reader->sampleRate <= 0 || reader->lengthInSamples <= 0)
+        {
+            return;
+        }
+
+        BeatDetector beats(reader->sampleRate);
+        KeyDetector key(reader->sampleRate);
+
+        const int numChannels = jlimit(1, 2, (int)reader->numChannels);
+        AudioBuffer<float> buffer(numChannels, chunkSize);
+
+        for (int64 pos = 0; pos < reader->lengthInSamples; pos += chunkSize)
+        {
+            if (shouldExit())
+            {
+                result.cancelled = true;
+                return;
+            }
+
+            const int numSamples = (int)jmin((int64)chunkSize, reader->lengthInSamples - pos);
+            if (!reader->read(&buffer, 0, numSamples, pos, true, numChannels > 1))
+            {
+                return;
+            }
+            if (numChannels > 1)
+            {
+                buffer.addFrom(0, 0, buffer, 1, 0, numSamples);
+                buffer.applyGain(0, 0, numSamples, 0.5f);
+            }
+
+            beats.process(buffer.getReadPointer(0), numSamples);
+            key.process(buffer.getReadPointer(0), numSamples);
+        }
+
+        result.analysed = true;
+        if (beats.finish())
+        {
+            result.bpm = beats.getBpm();
+            result.firstBeatSeconds = beats.getFirstBeatSeconds();
+        }
+        if (key.finish())
+        {
+            result.key = key.getKey();
+        }
+    }
+
+    //about one and a half seconds of audio at a time
+    enum { chunkSize = 65536 };
+
+    TrackAnalyser& owner;
+    int trackIndex;
+    File file;
+};
+
+
+//==============================================================================
+TrackAnalyser::TrackAnalyser(AudioFormatManager& _formatManager, PcmFileCache& _pcmCache)
+    : formatManager(_formatManager),
+      pcmCache(_pcmCache),
+      pool(SystemStats::getNumCpus())
+{
+    //below the message and audio threads, so analysing a large library never makes the UI or playback stutter
+    pool.setThreadPriorities(3);
+}
+
+TrackAnalyser::~TrackAnalyser()
+{
+    stopTimer();
+    //stop workers before the members they report to are destroyed
+    pool.removeAllJobs(true, 5000);
+}
+
+void TrackAnalyser::addListener(Listener* listener)
+{
+    listeners.add(listener);
+}
+
+void TrackAnalyser::removeListener(Listener* listener)
+{
+    listeners.remove(listener);
+}
+
+
+//==============================================================================
+void TrackAnalyser::analyseFile(int trackIndex, const File& file)
+{
+    //already queued, its result will arrive with the current batch
+    if (!outstandingTracks.insert(trackIndex).second)
+    {
+        return;
+    }
+    ++numQueued;
+
+    pool.addJob(new AnalysisJob(*this, trackIndex, file), true);
+
+    //deliver results in batches, 10 times per second
+    if (!isTimerRunning())
+    {
+        startTimer(100);
+    }
+}
+
+void TrackAnalyser::cancelAll()
+{
+    //interrupt running jobs and drop the queued ones
+    pool.removeAllJobs(true, 5000);
+
+    //tracks that never got a result are reported as cancelled
+    {
+        const ScopedLock sl(resultsLock);
+        for (const Result& r : pendingResults)
+        {
+            outstandingTracks.erase(r.trackIndex);
+        }
+        for (int trackIndex : outstandingTracks)
+        {
+            Result cancelled;
+            cancelled.trackIndex = trackIndex;
+            cancelled.cancelled = true;
+            pendingResults.push_back(cancelled);
+        }
+    }
+    numCompleted = numQueued.load();
+
+    timerCallback();
+}
+
+bool TrackAnalyser::isAnalysing() const
+{
+    return !outstandingTracks.empty();
+}
+
+
+//==============================================================================
+void TrackAnalyser::addResult(const Result& result)
+{
+    const ScopedLock sl(resultsLock);
+    pendingResults.push_back(result);
+    ++numCompleted;
+}
+
+void TrackAnalyser::timerCallback()
+{
+    //swap out the pending results so workers are only blocked for the swap
+    deliveredResults.clear();
+    {
+        const ScopedLock sl(resultsLock);
+        std::swap(pendingResults, deliveredResults);
+    }
+
+    for (const Result& r : deliveredResults)
+    {
+        outstandingTracks.erase(r.trackIndex);
+    }
+
+    if (!deliveredResults.empty())
+    {
+        listeners.call([this](Listener& l) { l.analysisResultsReady(deliveredResults); });
+    }
+
+    const int completed = numCompleted.load();
+    const int total = numQueued.load();
+    listeners.call([completed, total](Listener& l) { l.analysisProgressChanged(completed, total); });
+
+    //everything reported, reset progress for the next batch
+    if (outstandingTracks.empty())
+    {
+        numQueued = 0;
+        numCompleted = 0;
+        stopTimer();
+    }
+}
@@ -0,0 +1,108 @@
+/*
+  ==============================================================================
+
+    TrackAnalyser.h
+    Author:  Shamie
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <unordered_set>
+#include <vector>
+#include "PcmFileCache.h"
+
+//===============================================================================
+/*
+    Works out the tempo, beat grid and key of library tracks on a pool of background threads,
+    one track per thread. Each track is decoded once, a chunk at a time, and fed to every detector,
+    so memory use does not grow with the length of the track, and tracks already in the
+    PCM cache are read from its mapped file rather than decoded again.
+    Results are collected and handed back to listeners in batches on the message thread.
+*/
+
+class TrackAnalyser : private Timer
+{
+public:
+
+    //==============================================================================
+    /**Analysis of a single track*/
+    struct Result
+    {
+        int trackIndex = -1;
+        //false if the track could not be read
+        bool analysed = false;
+        //true if the analysis was abandoned before it finished
+        bool cancelled = false;
+
+        //0 if the track has no steady beat
+        double bpm = 0.0;
+        //time of the first downbeat, the origin of the beat grid
+        double firstBeatSeconds = 0.0;
+        //key in Camelot order, see KeyDetector, or -1 if the track has no tonal content
+        int key = -1;
+    };
+
+    /**Receives analysis results and progress updates, always on the message thread*/
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+        /**Called with every result that has finished since the last batch*/
+        virtual void analysisResultsReady(const std::vector<Result>& results) = 0;
+        /**Called after each batch with the number of completed and total tracks of the current batch of analysis*/
+        virtual void analysisProgressChanged(int numCompleted, int numTotal) = 0;
+    };
+
+    //==============================================================================
+    TrackAnalyser(AudioFormatManager& formatManager, PcmFileCache& pcmCache);
+    ~TrackAnalyser() override;
+
+    void addListener(Listener* listener);
+    void removeListener(Listener* listener);
+
+    //==============================================================================
+    /**Queue a track to be analysed, identified by its index in the library*/
+    void analyseFile(int trackIndex, const File& file);
+    /**Abandon all queued and running analysis. Unfinished tracks are reported as cancelled*/
+    void cancelAll();
+
+    /**True while there are tracks queued, being analysed, or waiting to be reported*/
+    bool isAnalysing() const;
+
+private:
+
+    class AnalysisJob;
+
+    //==============================================================================
+    /**Override of Timer pure virtual. Delivers collected results to listeners in one batch*/
+    void timerCallback() override;
+
+    /**Called by the worker threads once a track has been analysed*/
+    void addResult(const Result& result);
+
+    AudioFormatManager& formatManager;
+    PcmFileCache& pcmCache;
+
+    //pool sized to use every core of the machine
+    ThreadPool pool;
+
+    //results waiting to be delivered to the message thread
+    CriticalSection resultsLock;
+    std::vector<Result> pendingResults;
+    std::vector<Result> deliveredResults;
+
+    //indices of tracks queued but not yet reported, used to report cancelled tracks
+    std::unordered_set<int> outstandingTracks;
+
+    //progress of the current batch, reset once everything has been reported
+    std::atomic<int> numQueued{ 0 };
+    std::atomic<int> numCompleted{ 0 };
+
+    ListenerList<Listener> listeners;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TrackAnalyser)
+};
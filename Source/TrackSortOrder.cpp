@@ -0,0 +1,179 @@
+/*
+  ==============================================================================
+
+    TrackSortOrder.cpp
+    Author:  Shamie
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "TrackSortOrder.h"
+#include <algorithm>
+#include <limits>
+
+//==============================================================================
+TrackSortOrder::TrackSortOrder()
+{}
+
+void TrackSortOrder::setColumn(Column newColumn, bool shouldSortForwards)
+{
+    if (newColumn != column)
+    {
+        column = newColumn;
+        orderValid = false;
+    }
+    //the direction only changes which end the known values are read from
+    forwards = shouldSortForwards;
+}
+
+void TrackSortOrder::tracksChanged()
+{
+    orderValid = false;
+}
+
+
+//==============================================================================
+void TrackSortOrder::apply(const TrackStore& tracks,
+    const std::vector<TrackStore::TrackId>& matches,
+    std::vector<TrackStore::TrackId>& dest)
+{
+    if (column == unsorted)
+    {
+        dest = matches;
+        return;
+    }
+
+    if (!orderValid || (int)order.size() != tracks.getNumTracks())
+    {
+        updateOrder(tracks);
+    }
+
+    const int numTracks = tracks.getNumTracks();
+    dest.clear();
+    dest.reserve(matches.size());
+
+    //every track matches, no need to check each one. Otherwise mark the matches,
+    //then walk the permutation keeping the marked tracks
+    const bool allMatch = (int)matches.size() == numTracks;
+    if (!allMatch)
+    {
+        isMatch.assign(numTracks, 0);
+        for (TrackStore::TrackId id : matches)
+        {
+            isMatch[id] = 1;
+        }
+    }
+
+    //unknown values stay last, in the order they were added, whichever way the known values run
+    appendRange(0, numKnown, !forwards, allMatch, dest);
+    appendRange(numKnown, numTracks, false, allMatch, dest);
+}
+
+void TrackSortOrder::appendRange(int start, int end, bool backwards, bool allMatch, std::vector<TrackStore::TrackId>& dest) const
+{
+    for (int i = 0; i < end - start; ++i)
+    {
+        const TrackStore::TrackId id = order[backwards ? end - 1 - i : start + i];
+        if (allMatch || isMatch[id])
+        {
+            dest.push_back(id);
+        }
+    }
+}
+
+
+//==============================================================================
+void TrackSortOrder::updateOrder(const TrackStore& tracks)
+{
+    const int numTracks = tracks.getNumTracks();
+    //values not known yet are sorted after every known value
+    const double unknown = std::numeric_limits<double>::max();
+
+    if (column == byTitle)
+    {
+        updateTitleRanks(tracks);
+    }
+
+    sortKeys.resize(numTracks);
+    for (int id = 0; id < numTracks; ++id)
+    {
+        switch (column)
+        {
+        case byTitle:
+            sortKeys[id] = titleRanks[id];
+            break;
+        case byDuration:
+            sortKeys[id] = tracks.getDuration(id) < 0 ? unknown : tracks.getDuration(id);
+            break;
+        case byBpm:
+            sortKeys[id] = tracks.getBpm(id) <= 0 ? unknown : tracks.getBpm(id);
+            break;
+        case byKey:
+            sortKeys[id] = tracks.getKey(id) < 0 ? unknown : tracks.getKey(id);
+            break;
+        case byDateAdded:
+            sortKeys[id] = tracks.getDateAdded(id) <= 0 ? unknown : (double)tracks.getDateAdded(id);
+            break;
+        case unsorted:
+        default:
+            sortKeys[id] = id;
+            break;
+        }
+    }
+
+    order.resize(numTracks);
+    for (int id = 0; id < numTracks; ++id)
+    {
+        order[id] = id;
+    }
+
+    //ties keep the order the tracks were added in
+    const std::vector<double>& keys = sortKeys;
+    std::sort(order.begin(), order.end(), [&keys](TrackStore::TrackId a, TrackStore::TrackId b)
+    {
+        if (keys[a] != keys[b])
+        {
+            return keys[a] < keys[b];
+        }
+        return a < b;
+    });
+
+    //the unknown values are all at the end
+    numKnown = (int)(std::lower_bound(order.begin(), order.end(), unknown,
+        [&keys](TrackStore::TrackId id, double value) { return keys[id] < value; }) - order.begin());
+
+    orderValid = true;
+}
+
+void TrackSortOrder::updateTitleRanks(const TrackStore& tracks)
+{
+    const int numTracks = tracks.getNumTracks();
+    if ((int)titleRanks.size() == numTracks)
+    {
+        return;
+    }
+
+    std::vector<TrackStore::TrackId> byName((size_t)numTracks);
+    for (int id = 0; id < numTracks; ++id)
+    {
+        byName[id] = id;
+    }
+
+    std::sort(byName.begin(), byName.end(), [&tracks](TrackStore::TrackId a, TrackStore::TrackId b)
+    {
+        return tracks.getTitle(a).compareNatural(tracks.getTitle(b)) < 0;
+    });
+
+    //equal titles share a rank
+    titleRanks.resize(numTracks);
+    int rank = 0;
+    for (int i = 0; i < numTracks; ++i)
+    {
+        if (i > 0 && tracks.getTitle(byName[i]).compareNatural(tracks.getTitle(byName[i - 1])) != 0)
+        {
+            ++rank;
+        }
+        titleRanks[byName[i]] = rank;
+    }
+}
@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    TrackSortOrder.h
+    Author:  Shamie
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include "TrackStore.h"
+
+//===============================================================================
+/*
+    Orders the tracks of the library by one of its columns.
+    The order of every track is kept as a permutation of track ids, built from numeric
+    sort keys. Titles are first given a rank by natural string comparison, so only
+    adding tracks requires comparing strings again. Putting a set of search results in order
+    is then a single pass over the permutation, and reversing it costs nothing.
+    Tracks whose value is not known yet come last in either direction.
+*/
+
+class TrackSortOrder
+{
+public:
+
+    /**Columns the library can be sorted by*/
+    enum Column
+    {
+        unsorted,
+        byTitle,
+        byDuration,
+        byBpm,
+        byKey,
+        byDateAdded
+    };
+
+    TrackSortOrder();
+
+    //==============================================================================
+    /**Set the column to sort by, and whether the order is ascending*/
+    void setColumn(Column column, bool forwards);
+    /**Must be called when tracks are added or the values of the sorted column change*/
+    void tracksChanged();
+
+    /**Fill dest with the given tracks in sorted order. If matches holds every track in the store,
+    the permutation is copied as it is*/
+    void apply(const TrackStore& tracks,
+        const std::vector<TrackStore::TrackId>& matches,
+        std::vector<TrackStore::TrackId>& dest);
+
+private:
+
+    /**Rebuild the permutation of all tracks for the current column*/
+    void updateOrder(const TrackStore& tracks);
+    /**Rank every title, so that titles can be sorted as numbers*/
+    void updateTitleRanks(const TrackStore& tracks);
+    /**Append the tracks of order[start, end) to dest, backwards if asked, keeping only matches unless every track matches*/
+    void appendRange(int start, int end, bool backwards, bool allMatch, std::vector<TrackStore::TrackId>& dest) const;
+
+    Column column = unsorted;
+    bool forwards = true;
+
+    //every track id, in ascending order of the current column, followed by the tracks whose value is not known
+    std::vector<TrackStore::TrackId> order;
+    int numKnown = 0;
+    bool orderValid = false;
+
+    //collation rank of each title, recomputed only when tracks are added
+    std::vector<int> titleRanks;
+
+    //scratch buffers, kept to avoid allocating on every sort
+    std::vector<double> sortKeys;
+    std::vector<uint8> isMatch;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TrackSortOrder)
+};
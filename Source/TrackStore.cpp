@@ -0,0 +1,111 @@
+/*
+  ==============================================================================
+
+    TrackStore.cpp
+    Author:  Shamie
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "TrackStore.h"
+#include <cstring>
+
+//==============================================================================
+TrackStore::TrackStore()
+{
+    clear();
+}
+
+TrackStore::~TrackStore()
+{}
+
+void TrackStore::clear()
+{
+    arenaBlocks.clear();
+    //mark the (missing) current block as full so the first string allocates one
+    arenaBlockUsed = arenaBlockSize;
+
+    paths.clear();
+    titles.clear();
+    durations.clear();
+    bpms.clear();
+    firstBeats.clear();
+    keys.clear();
+    analysed.clear();
+    datesAdded.clear();
+    pathLookup.clear();
+}
+
+
+//==============================================================================
+TrackStore::TrackId TrackStore::addTrack(const String& path, const String& title, int duration, bool& wasAdded)
+{
+    TrackId existing = findTrack(path);
+    if (existing >= 0)
+    {
+        wasAdded = false;
+        return existing;
+    }
+
+    const TrackId id = getNumTracks();
+    const char* utf8 = path.toRawUTF8();
+
+    paths.push_back(storeString(utf8, std::strlen(utf8)));
+    titles.push_back(title);
+    durations.push_back(duration);
+    bpms.push_back(0.0);
+    firstBeats.push_back(0.0);
+    keys.push_back(-1);
+    analysed.push_back(false);
+    datesAdded.push_back(Time::currentTimeMillis());
+    pathLookup.emplace(path.hashCode64(), id);
+
+    wasAdded = true;
+    return id;
+}
+
+TrackStore::TrackId TrackStore::findTrack(const String& path) const
+{
+    const char* utf8 = path.toRawUTF8();
+
+    auto range = pathLookup.equal_range(path.hashCode64());
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (std::strcmp(paths[it->second], utf8) == 0)
+        {
+            return it->second;
+        }
+    }
+    return -1;
+}
+
+
+//==============================================================================
+const char* TrackStore::storeString(const char* utf8, size_t numBytes)
+{
+    const size_t needed = numBytes + 1;
+
+    //long strings get a block of their own, the current block keeps filling up
+    if (needed > (size_t)arenaBlockSize)
+    {
+        std::unique_ptr<char[]> block(new char[needed]);
+        char* dest = block.get();
+        arenaBlocks.insert(arenaBlocks.end() - (arenaBlocks.empty() ? 0 : 1), std::move(block));
+        std::memcpy(dest, utf8, numBytes);
+        dest[numBytes] = '\0';
+        return dest;
+    }
+
+    if (arenaBlockUsed + needed > (size_t)arenaBlockSize)
+    {
+        arenaBlocks.emplace_back(new char[arenaBlockSize]);
+        arenaBlockUsed = 0;
+    }
+
+    char* dest = arenaBlocks.back().get() + arenaBlockUsed;
+    std::memcpy(dest, utf8, numBytes);
+    dest[numBytes] = '\0';
+    arenaBlockUsed += needed;
+    return dest;
+}
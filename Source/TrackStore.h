@@ -0,0 +1,100 @@
+/*
+  ==============================================================================
+
+    TrackStore.h
+    Author:  Shamie
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+//===============================================================================
+/*
+    Holds every track in the library as a set of columns indexed by track id.
+    Ids are assigned in the order tracks are added and never change, so views of
+    the library (search results, sorted orders, playlists) are just vectors of ids.
+    File paths are interned: each distinct path is stored once, in large blocks of memory
+    shared by all tracks rather than in an allocation of its own.
+*/
+
+class TrackStore
+{
+public:
+
+    typedef int TrackId;
+
+    TrackStore();
+    ~TrackStore();
+
+    //==============================================================================
+    /**Remove every track. Previously returned ids and paths are no longer valid*/
+    void clear();
+    /**Number of tracks in the store, ids run from 0 to this value - 1*/
+    int getNumTracks() const { return (int)paths.size(); }
+
+    /**Returns the id of the track with this path, adding the track if it is not in the store yet.
+    wasAdded is set to true if a new track was created*/
+    TrackId addTrack(const String& path, const String& title, int duration, bool& wasAdded);
+    /**Returns the id of the track with this path, or -1 if it is not in the store*/
+    TrackId findTrack(const String& path) const;
+
+    //==============================================================================
+    /**Path of the track as a null terminated UTF-8 string, valid until the store is cleared*/
+    const char* getPath(TrackId id) const { return paths[id]; }
+    File getFile(TrackId id) const { return File{ CharPointer_UTF8(paths[id]) }; }
+    const String& getTitle(TrackId id) const { return titles[id]; }
+
+    int getDuration(TrackId id) const { return durations[id]; }
+    void setDuration(TrackId id, int duration) { durations[id] = duration; }
+
+    /**Tempo in beats per minute, 0 if the track has not been analysed or has no steady beat*/
+    double getBpm(TrackId id) const { return bpms[id]; }
+    void setBpm(TrackId id, double bpm) { bpms[id] = bpm; }
+
+    /**Time of the first downbeat in seconds, the origin of the beat grid, 0 if the track has not been analysed*/
+    double getFirstBeatSeconds(TrackId id) const { return firstBeats[id]; }
+    void setFirstBeatSeconds(TrackId id, double seconds) { firstBeats[id] = seconds; }
+
+    /**Musical key, numbered in Camelot order as by KeyDetector, -1 if the track has not been analysed or has no key*/
+    int getKey(TrackId id) const { return keys[id]; }
+    void setKey(TrackId id, int key) { keys[id] = key; }
+
+    /**True once the track has been through analysis, even if no tempo or key was found in it*/
+    bool isAnalysed(TrackId id) const { return analysed[id]; }
+    void setAnalysed(TrackId id, bool isAnalysed) { analysed[id] = isAnalysed; }
+
+    /**Time the track was added to the library, in milliseconds since 1970, 0 if it is not known*/
+    int64 getDateAdded(TrackId id) const { return datesAdded[id]; }
+    void setDateAdded(TrackId id, int64 dateAdded) { datesAdded[id] = dateAdded; }
+
+private:
+
+    /**Copy the bytes and a null terminator into the arena, returning the stored copy*/
+    const char* storeString(const char* utf8, size_t numBytes);
+
+    //memory the paths are stored in, each block is filled before the next is allocated
+    std::vector<std::unique_ptr<char[]>> arenaBlocks;
+    size_t arenaBlockUsed;
+    enum { arenaBlockSize = 64 * 1024 };
+
+    //columns, one element per track
+    std::vector<const char*> paths;
+    std::vector<String> titles;
+    std::vector<int> durations;
+    std::vector<double> bpms;
+    std::vector<double> firstBeats;
+    std::vector<int> keys;
+    std::vector<bool> analysed;
+    std::vector<int64> datesAdded;
+
+    //tracks by hash of their path, to find existing tracks without storing the path again
+    std::unordered_multimap<int64, TrackId> pathLookup;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TrackStore)
+};
@@ -9,74 +9,282 @@
 
 #include <JuceHeader.h>
 #include "WaveformDisplay.h"
+#include <cmath>
+
+//==============================================================================
+class WaveformDisplay::PyramidJob : public ThreadPoolJob
+{
+public:
+    PyramidJob(WaveformDisplay& _owner, const URL& _audioURL)
+        : ThreadPoolJob("WaveformDisplay::PyramidJob"),
+          owner(_owner),
+          audioURL(_audioURL)
+    {}
+
+    JobStatus runJob() override
+    {
+        //the decoded PCM file is much cheaper to read than the original when it exists
+        std::unique_ptr<AudioFormatReader> reader(owner.pcmCache.createMappedReader(audioURL));
+        if (reader == nullptr)
+        {
+            reader.reset(owner.formatManager.createReaderFor(audioURL.createInputStream(false)));
+        }
+        if (reader == nullptr)
+        {
+            return jobHasFinished;
+        }
+
+        std::unique_ptr<WaveformPyramid> built(new WaveformPyramid());
+        if (built->build(*reader, [this] { return shouldExit(); }))
+        {
+            const ScopedLock sl(owner.builtPyramidLock);
+            owner.builtPyramid = std::move(built);
+            owner.triggerAsyncUpdate();
+        }
+        return jobHasFinished;
+    }
+
+private:
+    WaveformDisplay& owner;
+    URL audioURL;
+};
+
 
 //==============================================================================
 WaveformDisplay::WaveformDisplay(AudioFormatManager & formatManagerToUse,
-                                AudioThumbnailCache & cacheToUse) : 
-                                audioThumb(1000, formatManagerToUse, cacheToUse),
-                                fileLoaded(false), 
+                                AudioThumbnailCache & cacheToUse,
+                                PcmFileCache & pcmCacheToUse) :
+                                formatManager(formatManagerToUse),
+                                audioThumb(DiskThumbnailCache::samplesPerThumbnail, formatManagerToUse, cacheToUse),
+                                pcmCache(pcmCacheToUse),
+                                fileLoaded(false),
                                 position(0)
 {
-  
+    //playheads are hidden until a track is loaded
+    addChildComponent(overviewPlayhead);
+    addChildComponent(zoomPlayhead);
+
     audioThumb.addChangeListener(this);
 }
 
-WaveformDisplay::~WaveformDisplay(){}
+WaveformDisplay::~WaveformDisplay()
+{
+    pyramidPool.removeAllJobs(true, 5000);
+    cancelPendingUpdate();
+}
 
 
 //==============================================================================
 void WaveformDisplay::paint(juce::Graphics& g)
 {
-    g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
-
-    //draw borders 
-    g.setColour(juce::Colours::grey);
-    g.drawRect(getLocalBounds(), 1);
-
     //if file is loaded, draw waveforms
     if (fileLoaded)
     {
-        //draw waveforms in red
-        g.setColour(juce::Colours::crimson);
-        audioThumb.drawChannel(g,
-            getLocalBounds(), // area
-            0, //start time
-            audioThumb.getTotalLength(), //length of file as end time
-            0,
-            1.0f
-        );
-
-        //draw playhead in green
-        g.setColour(juce::Colours::mediumspringgreen);
-        g.fillRect(position * getWidth(), 0, 2, getHeight());
+        checkCacheImageType();
+        if (overviewImage.isNull())
+        {
+            renderOverview();
+        }
+        g.drawImageAt(overviewImage, overviewArea.getX(), overviewArea.getY());
 
-        //display name of currently playing track on the waveform in white
-        g.setColour(juce::Colours::floralwhite);
-        g.setFont(16.0f);
-        g.drawText(nowPlaying, getLocalBounds(),
-            juce::Justification::centred, true);
+        if (g.clipRegionIntersects(zoomArea))
+        {
+            paintZoomed(g);
+        }
+
+        //draw borders
+        g.setColour(juce::Colours::grey);
+        g.drawRect(getLocalBounds(), 1);
     }
     else
     {
-        //file not loaded 
+        g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
+
+        //draw borders
+        g.setColour(juce::Colours::grey);
+        g.drawRect(getLocalBounds(), 1);
+
+        //file not loaded
         g.setColour(juce::Colours::mediumspringgreen);
         g.setFont(20.0f);
         g.drawText("Load File to Channel to Begin...", getLocalBounds(),
             juce::Justification::centred, true);
     }
 }
+
+void WaveformDisplay::renderOverview()
+{
+    overviewImage = createCacheImage(jmax(1, overviewArea.getWidth()), jmax(1, overviewArea.getHeight()));
+    Graphics g(overviewImage);
+    g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
+
+    //draw waveforms in red
+    g.setColour(juce::Colours::crimson);
+    audioThumb.drawChannel(g,
+        overviewImage.getBounds(),
+        0, //start time
+        audioThumb.getTotalLength(), //length of file as end time
+        0,
+        1.0f
+    );
+
+    g.setColour(juce::Colours::grey);
+    g.drawHorizontalLine(overviewImage.getHeight() - 1, 0.0f, (float)overviewImage.getWidth());
+
+    //display name of currently playing track on the overview in white
+    g.setColour(juce::Colours::floralwhite);
+    g.setFont(16.0f);
+    g.drawText(nowPlaying, overviewImage.getBounds().reduced(4),
+        juce::Justification::centredLeft, true);
+}
+
+void WaveformDisplay::renderZoomed(double startSample, double samplesPerPixel)
+{
+    const int width = zoomArea.getWidth() * 3;
+    zoomImage = createCacheImage(width, zoomArea.getHeight());
+    zoomImageStartSample = startSample;
+    zoomImageSamplesPerPixel = samplesPerPixel;
+
+    peaks.resize((size_t)width);
+    pyramid->getPeaks(startSample, samplesPerPixel, peaks.data(), width);
+
+    Graphics g(zoomImage);
+    g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
+
+    const float centreY = zoomImage.getHeight() * 0.5f;
+    const float halfHeight = zoomImage.getHeight() * 0.5f;
+
+    //peaks in dark red, with the RMS level drawn brighter inside them
+    g.setColour(juce::Colours::crimson.darker(0.5f));
+    for (int x = 0; x < width; ++x)
+    {
+        g.drawVerticalLine(x,
+            centreY - peaks[(size_t)x].max * halfHeight,
+            centreY - peaks[(size_t)x].min * halfHeight + 1.0f);
+    }
+    g.setColour(juce::Colours::crimson);
+    for (int x = 0; x < width; ++x)
+    {
+        const float rms = peaks[(size_t)x].rms * halfHeight;
+        g.drawVerticalLine(x, centreY - rms, centreY + rms + 1.0f);
+    }
+}
+
+void WaveformDisplay::paintZoomed(Graphics& g)
+{
+    const int width = zoomArea.getWidth();
+    if (pyramid == nullptr || width <= 0)
+    {
+        g.setColour(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
+        g.fillRect(zoomArea);
+        g.setColour(juce::Colours::grey);
+        g.setFont(14.0f);
+        g.drawText("Building waveform...", zoomArea, juce::Justification::centred, true);
+        return;
+    }
+
+    //playhead stays in the centre and the track scrolls past it
+    const double samplesPerPixel = zoomSeconds * pyramid->getSampleRate() / width;
+    const double playheadSample = position * pyramid->getLengthInSamples();
+    const double viewStart = playheadSample - samplesPerPixel * width / 2;
+
+    //the image covers a view width either side, so it is only rendered again after scrolling that far
+    const double imageEnd = zoomImageStartSample + zoomImage.getWidth() * zoomImageSamplesPerPixel;
+    if (zoomImage.isNull()
+        || samplesPerPixel != zoomImageSamplesPerPixel
+        || zoomImage.getHeight() != zoomArea.getHeight()
+        || viewStart < zoomImageStartSample
+        || viewStart + width * samplesPerPixel > imageEnd)
+    {
+        renderZoomed(viewStart - width * samplesPerPixel, samplesPerPixel);
+    }
+
+    const int offset = roundToInt((viewStart - zoomImageStartSample) / samplesPerPixel);
+    Graphics::ScopedSaveState state(g);
+    g.reduceClipRegion(zoomArea);
+    g.drawImageAt(zoomImage, zoomArea.getX() - offset, zoomArea.getY());
+}
+
+Image WaveformDisplay::createCacheImage(int width, int height)
+{
+    if (cacheImagesOnOpenGL)
+    {
+        return Image(OpenGLImageType().create(Image::ARGB, width, height, true));
+    }
+    return Image(Image::RGB, width, height, true);
+}
+
+void WaveformDisplay::checkCacheImageType()
+{
+    //paint runs on the OpenGL thread with its context active when the window is rendered through OpenGL
+    const bool onOpenGL = OpenGLContext::getCurrentContext() != nullptr;
+    if (onOpenGL != cacheImagesOnOpenGL)
+    {
+        cacheImagesOnOpenGL = onOpenGL;
+        overviewImage = Image();
+        zoomImage = Image();
+    }
+}
+
 void WaveformDisplay::resized()
 {
+    //overview strip along the top quarter, zoomed view below it
+    Rectangle<int> area = getLocalBounds();
+    overviewArea = area.removeFromTop(getHeight() / 4);
+    zoomArea = area;
+
+    overviewImage = Image();
+    zoomImage = Image();
 
+    zoomPlayhead.setBounds(zoomArea.getCentreX() - 1, zoomArea.getY(), 2, zoomArea.getHeight());
+    updatePlayheads();
 }
 
+void WaveformDisplay::updatePlayheads()
+{
+    overviewPlayhead.setBounds(overviewArea.getX() + (int)(position * overviewArea.getWidth()),
+        overviewArea.getY(), 2, overviewArea.getHeight());
+}
+
+void WaveformDisplay::mouseWheelMove(const MouseEvent& event, const MouseWheelDetails& wheel)
+{
+    //scrolling up zooms in
+    setZoomSeconds(zoomSeconds * std::pow(2.0, -wheel.deltaY * 2.0));
+}
+
+void WaveformDisplay::setZoomSeconds(double seconds)
+{
+    //from a few beats to the length of a long mix
+    seconds = jlimit(0.5, 600.0, seconds);
+    if (seconds != zoomSeconds)
+    {
+        zoomSeconds = seconds;
+        repaint(zoomArea);
+    }
+}
+
+
 //==============================================================================
 void WaveformDisplay::loadURL(URL audioURL)
 {
     audioThumb.clear();
-    fileLoaded = audioThumb.setSource(new URLInputSource(audioURL));
+
+    //stop building the waveform of the previous track
+    pyramidPool.removeAllJobs(true, 5000);
+    pyramid.reset();
+    {
+        const ScopedLock sl(builtPyramidLock);
+        builtPyramid.reset();
+    }
+    overviewImage = Image();
+    zoomImage = Image();
+
+    //keyed by the original file, so a stored thumbnail is found whichever file it was built from
+    fileLoaded = audioThumb.setSource(pcmCache.createInputSource(audioURL));
     if (fileLoaded)
     {
+        pyramidPool.addJob(new PyramidJob(*this, audioURL), true);
+
         std::string justFile = audioURL.toString(false).toStdString();
         std::size_t startFilePos = justFile.find_last_of("/");
         std::size_t startExtPos = justFile.find_last_of(".");
@@ -90,18 +298,38 @@ void WaveformDisplay::loadURL(URL audioURL)
     {
 
     }
+    overviewPlayhead.setVisible(fileLoaded);
+    zoomPlayhead.setVisible(fileLoaded);
+}
+
+void WaveformDisplay::handleAsyncUpdate()
+{
+    const ScopedLock sl(builtPyramidLock);
+    if (builtPyramid != nullptr)
+    {
+        pyramid = std::move(builtPyramid);
+        zoomImage = Image();
+        repaint(zoomArea);
+    }
 }
 
 void WaveformDisplay::changeListenerCallback(ChangeBroadcaster* source)
 {
-    repaint();
+    //the thumbnail has loaded more of the track
+    overviewImage = Image();
+    repaint(overviewArea);
 }
 
 void WaveformDisplay::setRelativePosition(double pos)
 {
     if (pos != position)
     {
-        position = pos; //update position 
-        repaint(); //then repaint
+        position = pos; //update position
+        //moving the playhead repaints only the strip it uncovers, the zoomed view scrolls its cached image
+        updatePlayheads();
+        if (pyramid != nullptr)
+        {
+            repaint(zoomArea);
+        }
     }
-}
\ No newline at end of file
+}
@@ -10,19 +10,30 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "PcmFileCache.h"
+#include "DiskThumbnailCache.h"
+#include "WaveformPyramid.h"
+#include <memory>
+#include <vector>
 
 //==============================================================================
 /*
-* This component enables waveforms of audio being played to be painted to the screen 
+* This component enables waveforms of audio being played to be painted to the screen.
+* A strip along the top shows the whole track, and below it a zoomed view scrolls with the
+* playhead fixed in the centre. The mouse wheel changes the zoom.
+* Waveforms are rendered into cached images, and the playheads are small child components,
+* so moving the playhead only repaints the pixels it uncovers and the zoomed view's image copy
 */
 
 class WaveformDisplay  : public juce::Component,
-                        public ChangeListener
+                        public ChangeListener,
+                        private AsyncUpdater
 {
 public:
 
-    WaveformDisplay(AudioFormatManager &formatManagerToUse, 
-            AudioThumbnailCache &cacheToUse);
+    WaveformDisplay(AudioFormatManager &formatManagerToUse,
+            AudioThumbnailCache &cacheToUse,
+            PcmFileCache &pcmCacheToUse);
     ~WaveformDisplay() override;
 
     //==============================================================================
@@ -30,9 +41,14 @@ public:
     void paint(juce::Graphics&) override;
     /**Rescaling of components on the application window*/
     void resized() override;
+    /**Zoom the scrolling view in or out*/
+    void mouseWheelMove(const MouseEvent& event, const MouseWheelDetails& wheel) override;
 
     //==============================================================================
-    /**Set source for audiothumb based on URL path and generates the name of nowPlaying song*/
+    /**Set source for audiothumb based on URL path and generates the name of nowPlaying song.
+    Reads the decoded PCM file instead of the original when the track is already in the cache,
+    and restores a thumbnail stored by an earlier load or the library import without reading either.
+    The zoomed waveform is built in the background*/
     void loadURL(URL audioURL);
 
     /**Listener to repaint whenever there has been a change to enable moving playhead*/
@@ -41,12 +57,67 @@ public:
     /** Set relative position of the playhead*/
     void setRelativePosition(double pos);
 
+    /**Set how many seconds of the track the zoomed view shows across its width*/
+    void setZoomSeconds(double seconds);
+
 private:
+    //==============================================================================
+    class PyramidJob;
+
+    /**Opaque 2 pixel wide bar, moved over the waveform instead of repainting it*/
+    class Playhead : public Component
+    {
+    public:
+        Playhead() { setOpaque(true); setInterceptsMouseClicks(false, false); }
+        void paint(Graphics& g) override { g.fillAll(juce::Colours::mediumspringgreen); }
+    };
+
+    /**Override of AsyncUpdater pure virtual. Takes a finished pyramid from the background thread*/
+    void handleAsyncUpdate() override;
 
+    /**Render the whole track with the thumbnail and the track name into overviewImage*/
+    void renderOverview();
+    /**Render the pyramid into zoomImage, three view widths wide and starting at startSample,
+    one column per pixel*/
+    void renderZoomed(double startSample, double samplesPerPixel);
+    /**Draw the part of zoomImage around the playhead, rendering it again if the view has moved past its edge*/
+    void paintZoomed(Graphics& g);
+    /**Move the overview playhead to the current position*/
+    void updatePlayheads();
+    /**Create an image for a cached render. When painting through OpenGL it is a texture,
+    so drawing it each frame is done by the GPU*/
+    Image createCacheImage(int width, int height);
+    /**Drop cached images made for a different renderer than the one now painting*/
+    void checkCacheImageType();
+
+    AudioFormatManager& formatManager;
     AudioThumbnail audioThumb;
+    PcmFileCache& pcmCache;
+
+    //zoomed waveform, built on the pool thread and handed over through builtPyramid
+    ThreadPool pyramidPool{ 1 };
+    std::unique_ptr<WaveformPyramid> pyramid;
+    CriticalSection builtPyramidLock;
+    std::unique_ptr<WaveformPyramid> builtPyramid;
+    //one peak per pixel of the zoomed image, reused on every render
+    std::vector<WaveformPyramid::Peak> peaks;
+
+    //cached renders, cleared when they need drawing again
+    Rectangle<int> overviewArea;
+    Rectangle<int> zoomArea;
+    Image overviewImage;
+    Image zoomImage;
+    double zoomImageStartSample = 0.0;
+    double zoomImageSamplesPerPixel = 0.0;
+    //whether the cached images are OpenGL textures
+    bool cacheImagesOnOpenGL = false;
+
+    Playhead overviewPlayhead;
+    Playhead zoomPlayhead;
 
     bool fileLoaded;
     double position;
+    double zoomSeconds = 8.0;
     std::string nowPlaying;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WaveformDisplay)
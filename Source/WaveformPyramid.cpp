@@ -0,0 +1,182 @@
+/*
+  ==============================================================================
+    WaveformPyramid.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "WaveformPyramid.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    //four independent sums, so the compiler can keep them in one vector register
+    float sumOfSquares(const float* samples, int numSamples)
+    {
+        float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+        int i = 0;
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            s0 += samples[i] * samples[i];
+            s1 += samples[i + 1] * samples[i + 1];
+            s2 += samples[i + 2] * samples[i + 2];
+            s3 += samples[i + 3] * samples[i + 3];
+        }
+        for (; i < numSamples; ++i)
+        {
+            s0 += samples[i] * samples[i];
+        }
+        return (s0 + s1) + (s2 + s3);
+    }
+}
+
+WaveformPyramid::WaveformPyramid()
+{}
+
+WaveformPyramid::~WaveformPyramid()
+{}
+
+
+//==============================================================================
+bool WaveformPyramid::build(AudioFormatReader& reader, const std::function<bool()>& shouldExit)
+{
+    levels.clear();
+    sampleRate = reader.sampleRate;
+    lengthInSamples = reader.lengthInSamples;
+    if (lengthInSamples <= 0 || sampleRate <= 0)
+    {
+        return false;
+    }
+
+    Level base;
+    base.samplesPerBucket = samplesPerBaseBucket;
+    const size_t numBuckets = (size_t)((lengthInSamples + samplesPerBaseBucket - 1) / samplesPerBaseBucket);
+    base.mins.reserve(numBuckets);
+    base.maxs.reserve(numBuckets);
+    base.meanSquares.reserve(numBuckets);
+    levels.push_back(std::move(base));
+
+    //a whole number of buckets per block, so buckets never span two blocks
+    const int blockSize = samplesPerBaseBucket * 1024;
+    const int numChannels = jlimit(1, 2, (int)reader.numChannels);
+    AudioBuffer<float> buffer(numChannels, blockSize);
+
+    for (int64 pos = 0; pos < lengthInSamples; pos += blockSize)
+    {
+        if (shouldExit())
+        {
+            return false;
+        }
+
+        const int numSamples = (int)jmin((int64)blockSize, lengthInSamples - pos);
+        if (!reader.read(&buffer, 0, numSamples, pos, true, numChannels > 1))
+        {
+            return false;
+        }
+
+        //mix to mono in place
+        float* mono = buffer.getWritePointer(0);
+        if (numChannels > 1)
+        {
+            FloatVectorOperations::add(mono, buffer.getReadPointer(1), numSamples);
+            FloatVectorOperations::multiply(mono, 0.5f, numSamples);
+        }
+        addBaseBuckets(mono, numSamples);
+    }
+
+    buildUpperLevels();
+    return true;
+}
+
+void WaveformPyramid::addBaseBuckets(const float* samples, int numSamples)
+{
+    Level& base = levels[0];
+    for (int start = 0; start < numSamples; start += samplesPerBaseBucket)
+    {
+        const int count = jmin((int)samplesPerBaseBucket, numSamples - start);
+        const Range<float> range = FloatVectorOperations::findMinAndMax(samples + start, count);
+        base.mins.push_back(range.getStart());
+        base.maxs.push_back(range.getEnd());
+        base.meanSquares.push_back(sumOfSquares(samples + start, count) / count);
+    }
+}
+
+void WaveformPyramid::buildUpperLevels()
+{
+    //stop once a level is small enough to draw a whole track in a few pixels
+    while (levels.back().mins.size() > 64)
+    {
+        const Level& below = levels.back();
+        const size_t numBelow = below.mins.size();
+
+        Level level;
+        level.samplesPerBucket = below.samplesPerBucket * 2;
+        const size_t numBuckets = (numBelow + 1) / 2;
+        level.mins.resize(numBuckets);
+        level.maxs.resize(numBuckets);
+        level.meanSquares.resize(numBuckets);
+
+        for (size_t i = 0; i < numBuckets; ++i)
+        {
+            const size_t a = i * 2;
+            const size_t b = jmin(a + 1, numBelow - 1);
+            level.mins[i] = jmin(below.mins[a], below.mins[b]);
+            level.maxs[i] = jmax(below.maxs[a], below.maxs[b]);
+            level.meanSquares[i] = 0.5f * (below.meanSquares[a] + below.meanSquares[b]);
+        }
+        levels.push_back(std::move(level));
+    }
+}
+
+
+//==============================================================================
+void WaveformPyramid::getPeaks(double startSample, double samplesPerPixel, Peak* dest, int numPixels) const
+{
+    if (levels.empty() || samplesPerPixel <= 0)
+    {
+        std::fill(dest, dest + numPixels, Peak());
+        return;
+    }
+
+    //coarsest level that still has at least one bucket per pixel, so each pixel reads one to three buckets
+    size_t levelIndex = 0;
+    while (levelIndex + 1 < levels.size() && levels[levelIndex + 1].samplesPerBucket <= samplesPerPixel)
+    {
+        ++levelIndex;
+    }
+    const Level& level = levels[levelIndex];
+    const int64 numBuckets = (int64)level.mins.size();
+
+    for (int x = 0; x < numPixels; ++x)
+    {
+        const double pixelStart = startSample + x * samplesPerPixel;
+        const double pixelEnd = pixelStart + samplesPerPixel;
+        if (pixelEnd <= 0 || pixelStart >= (double)lengthInSamples)
+        {
+            dest[x] = Peak();
+            continue;
+        }
+
+        int64 first = (int64)std::floor(pixelStart / level.samplesPerBucket);
+        int64 last = (int64)std::ceil(pixelEnd / level.samplesPerBucket);
+        first = jmax((int64)0, first);
+        last = jmin(numBuckets, jmax(last, first + 1));
+
+        Peak peak;
+        if (first < last)
+        {
+            peak.min = level.mins[(size_t)first];
+            peak.max = level.maxs[(size_t)first];
+            float meanSquare = 0.0f;
+            for (int64 i = first; i < last; ++i)
+            {
+                peak.min = jmin(peak.min, level.mins[(size_t)i]);
+                peak.max = jmax(peak.max, level.maxs[(size_t)i]);
+                meanSquare += level.meanSquares[(size_t)i];
+            }
+            peak.rms = std::sqrt(meanSquare / (float)(last - first));
+        }
+        dest[x] = peak;
+    }
+}
@@ -0,0 +1,71 @@
+/*
+  ==============================================================================
+    WaveformPyramid.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include <vector>
+
+//===============================================================================
+/*
+    Min, max and RMS of a track at several resolutions. The finest level summarises every
+    64 samples and each level above halves the resolution, so any zoom level can be drawn
+    by reading at most a few summaries per pixel.
+*/
+class WaveformPyramid
+{
+public:
+
+    /**Summary of a range of samples, with the channels mixed to mono*/
+    struct Peak
+    {
+        float min = 0.0f;
+        float max = 0.0f;
+        float rms = 0.0f;
+    };
+
+    enum { samplesPerBaseBucket = 64 };
+
+    WaveformPyramid();
+    ~WaveformPyramid();
+
+    //==============================================================================
+    /**Read the whole track and build every level. Stops and returns false if shouldExit returns true,
+    or the reader fails*/
+    bool build(AudioFormatReader& reader, const std::function<bool()>& shouldExit);
+
+    double getSampleRate() const { return sampleRate; }
+    int64 getLengthInSamples() const { return lengthInSamples; }
+
+    //==============================================================================
+    /**Fill one Peak per pixel, the first pixel starting at startSample. Pixels outside the track are silent.
+    Costs O(numPixels) whatever the zoom level*/
+    void getPeaks(double startSample, double samplesPerPixel, Peak* dest, int numPixels) const;
+
+private:
+    //==============================================================================
+    struct Level
+    {
+        int samplesPerBucket;
+        std::vector<float> mins;
+        std::vector<float> maxs;
+        //mean of the squared samples, averaged when levels are combined and square rooted when drawn
+        std::vector<float> meanSquares;
+    };
+
+    /**Summarise a block of mono samples into the base level*/
+    void addBaseBuckets(const float* samples, int numSamples);
+    /**Build each coarser level from the one below it*/
+    void buildUpperLevels();
+
+    std::vector<Level> levels;
+    double sampleRate = 0.0;
+    int64 lengthInSamples = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformPyramid)
+};
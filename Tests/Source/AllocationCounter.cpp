@@ -0,0 +1,97 @@
+/*
+  ==============================================================================
+    AllocationCounter.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "AllocationCounter.h"
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    //constant initialised, so reading them never allocates
+    thread_local bool countingAllocations = false;
+    thread_local int numAllocations = 0;
+
+    void countAllocation()
+    {
+        if (countingAllocations)
+        {
+            ++numAllocations;
+        }
+    }
+}
+
+ScopedAllocationCounter::ScopedAllocationCounter()
+{
+    numAllocations = 0;
+    countingAllocations = true;
+}
+
+ScopedAllocationCounter::~ScopedAllocationCounter()
+{
+    countingAllocations = false;
+}
+
+int ScopedAllocationCounter::getNumAllocations() const
+{
+    return numAllocations;
+}
+
+
+//==============================================================================
+#if defined(__linux__) && defined(__GLIBC__)
+
+//operator new calls malloc, so replacing malloc counts both
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* block, size_t size);
+
+extern "C" void* malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* block, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(block, size);
+}
+
+#else
+
+void* operator new(std::size_t size)
+{
+    countAllocation();
+    if (void* block = std::malloc(size > 0 ? size : 1))
+    {
+        return block;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* block) noexcept
+{
+    std::free(block);
+}
+
+void operator delete[](void* block) noexcept
+{
+    std::free(block);
+}
+
+#endif
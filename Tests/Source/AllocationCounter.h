@@ -0,0 +1,29 @@
+/*
+  ==============================================================================
+    AllocationCounter.h
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#pragma once
+
+//===============================================================================
+/*
+    Counts the heap allocations made by the calling thread while it is in scope.
+    On Linux with glibc malloc itself is replaced, which also catches JUCE's HeapBlock
+    and AudioBuffer. Elsewhere only the global operator new is, which is replaced
+    for the whole test program.
+*/
+class ScopedAllocationCounter
+{
+public:
+    ScopedAllocationCounter();
+    ~ScopedAllocationCounter();
+
+    /**Allocations made on this thread since the counter was created*/
+    int getNumAllocations() const;
+
+private:
+    ScopedAllocationCounter(const ScopedAllocationCounter&) = delete;
+    ScopedAllocationCounter& operator=(const ScopedAllocationCounter&) = delete;
+};
@@ -0,0 +1,181 @@
+/*
+  ==============================================================================
+    DeckManagerTests.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "../../Source/DeckManager.h"
+#include "AllocationCounter.h"
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    const double sampleRate = 48000.0;
+    const int blockSize = 512;
+    const int numDecks = 4;
+
+    /**Write ten seconds of a stereo sine to a WAV file for the decks to play*/
+    bool writeTestTone(const File& file)
+    {
+        std::unique_ptr<FileOutputStream> stream(file.createOutputStream());
+        if (stream == nullptr)
+        {
+            return false;
+        }
+        WavAudioFormat wav;
+        std::unique_ptr<AudioFormatWriter> writer(wav.createWriterFor(stream.get(), sampleRate, 2, 16, {}, 0));
+        if (writer == nullptr)
+        {
+            return false;
+        }
+        //the writer owns the stream now
+        stream.release();
+
+        AudioBuffer<float> tone(2, (int)(10.0 * sampleRate));
+        for (int i = 0; i < tone.getNumSamples(); ++i)
+        {
+            const float sample = 0.5f * (float)std::sin(MathConstants<double>::twoPi * 220.0 * i / sampleRate);
+            tone.setSample(0, i, sample);
+            tone.setSample(1, i, sample);
+        }
+        return writer->writeFromAudioSampleBuffer(tone, 0, tone.getNumSamples());
+    }
+}
+
+//==============================================================================
+/**The decks are rendered and mixed on the audio thread, so once prepared the whole callback must never
+allocate, with or without a track loaded, whatever commands are waiting and however the mixer is set*/
+class DeckManagerTests : public UnitTest,
+    private DJAudioPlayer::Listener
+{
+public:
+    DeckManagerTests() : UnitTest("DeckManager", "OtoDecks") {}
+
+    void runTest() override
+    {
+        const File directory = File::getSpecialLocation(File::tempDirectory).getChildFile("OtoDecksTests");
+        directory.deleteRecursively();
+        directory.createDirectory();
+        const File toneFile = directory.getChildFile("tone.wav");
+
+        beginTest("Test track");
+        expect(writeTestTone(toneFile));
+
+        //everything is deleted before the directory, as the PCM cache may still be writing to it
+        {
+            AudioFormatManager formatManager;
+            formatManager.registerBasicFormats();
+            TimeSliceThread diskThread("Deck disk reader");
+            diskThread.startThread(8);
+            DecodedTrackCache decodedTracks((int64)64 * 1024 * 1024);
+            PcmFileCache pcmCache(formatManager, directory.getChildFile("PCM"), (int64)64 * 1024 * 1024);
+
+            DeckManager manager(numDecks, formatManager, diskThread, decodedTracks, pcmCache);
+            manager.prepareToPlay(blockSize, sampleRate);
+            manager.setSyncMaster(1);
+
+            //the first three decks get a track, streamed or from memory, and the last is left empty
+            numTracksLoaded = 0;
+            for (int deck = 0; deck < numDecks - 1; ++deck)
+            {
+                DJAudioPlayer* player = manager.getPlayer(deck);
+                player->addListener(this);
+                player->setRamResident(deck == 2);
+                player->loadURL(URL(toneFile), 120.0, 0.0);
+            }
+
+            //tracks are handed to the decks on the message thread
+            const uint32 timeout = Time::getMillisecondCounter() + 10000;
+            while (numTracksLoaded < numDecks - 1 && Time::getMillisecondCounter() < timeout)
+            {
+                MessageManager::getInstance()->runDispatchLoopUntil(10);
+            }
+            expectEquals(numTracksLoaded, numDecks - 1, "tracks loaded");
+
+            //two decks playing, one in sync with the master, and one left stopped
+            manager.getPlayer(0)->setSync(true);
+            manager.getPlayer(0)->start();
+            manager.getPlayer(1)->start();
+
+            //every deck on the audio thread, then shared with the render threads
+            beginTest("No allocation rendering and mixing on the audio thread");
+            manager.setMinimumParallelBlockSize(std::numeric_limits<int>::max());
+            expectEquals(renderBlocks(manager, 1), 0);
+
+            beginTest("No allocation on the audio thread with render threads");
+            manager.setMinimumParallelBlockSize(0);
+            expectEquals(renderBlocks(manager, 2), 0);
+
+            for (int deck = 0; deck < numDecks; ++deck)
+            {
+                manager.getPlayer(deck)->removeListener(this);
+            }
+            manager.releaseResources();
+        }
+
+        directory.deleteRecursively();
+    }
+
+private:
+    /**Render 500 blocks as the device would, moving the controls between them, and return the number of
+    allocations made by this thread while rendering*/
+    int renderBlocks(DeckManager& manager, int64 seed)
+    {
+        //master and cue bus
+        AudioBuffer<float> output(4, blockSize);
+        DeckMixer& mixer = manager.getMixer();
+        Random random(seed);
+
+        int numAllocations = 0;
+        for (int block = 0; block < 500; ++block)
+        {
+            //queue commands and move the mixer between blocks, as the message thread would
+            const int deck = block % numDecks;
+            DJAudioPlayer* player = manager.getPlayer(deck);
+            player->setGain(random.nextDouble());
+            player->setSpeed(0.8 + random.nextDouble() * 0.4);
+            switch (block % 8)
+            {
+            case 0: player->setHotCue(block % DeckLooper::numHotCues); break;
+            case 1: player->jumpToHotCue((block - 1) % DeckLooper::numHotCues); break;
+            case 2: player->setLoop(random.nextBool() ? 1.0 : 4.0); break;
+            case 3: player->exitLoop(); break;
+            case 4: player->setKeyLock(random.nextBool()); break;
+            case 5: player->setSync(random.nextBool()); break;
+            case 6: player->clearHotCue((block - 6) % DeckLooper::numHotCues); break;
+            default: manager.setSyncMaster(random.nextInt(numDecks)); break;
+            }
+
+            mixer.setTrim(deck, random.nextFloat() * 24.0f - 12.0f);
+            mixer.setEqGain(deck, (DeckMixer::Band)(block % DeckMixer::numBands), random.nextFloat() * 30.0f - 26.0f);
+            mixer.setFader(deck, random.nextFloat());
+            mixer.setCrossfaderSide(deck, (DeckMixer::CrossfaderSide)(block % 3));
+            mixer.setCue(deck, random.nextBool());
+            mixer.setCrossfader(random.nextFloat());
+            mixer.setCrossfaderCurve((DeckMixer::CrossfaderCurve)(block % 3));
+            mixer.setCueMix(random.nextFloat());
+
+            //short blocks too, as the device may hand over less than it promised
+            const int numSamples = block % 5 == 0 ? 37 : blockSize;
+
+            ScopedAllocationCounter counter;
+            manager.getNextAudioBlock(AudioSourceChannelInfo(&output, 0, numSamples));
+            numAllocations += counter.getNumAllocations();
+        }
+        return numAllocations;
+    }
+
+    void playerTrackLoaded(DJAudioPlayer*, const URL&, bool loadedOk) override
+    {
+        if (loadedOk)
+        {
+            ++numTracksLoaded;
+        }
+    }
+
+    int numTracksLoaded = 0;
+};
+
+static DeckManagerTests deckManagerTests;
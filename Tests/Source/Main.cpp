@@ -0,0 +1,40 @@
+/*
+  ==============================================================================
+    Main.cpp
+    Author:  Shamie
+
+    Runs the unit tests of the audio code, or with --benchmark the benchmarks.
+    The shared sources include <JuceHeader.h> from the header search path, so they are built
+    against this project's JuceLibraryCode. It uses the same modules and options as the app.
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const StringArray args(argv + 1, argc - 1);
+    //the decks are handed their tracks on the message thread
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+    UnitTestRunner runner;
+    runner.setAssertOnFailure(false);
+
+    //benchmarks only run when asked for, so a normal run stays quick
+    if (args.contains("--benchmark"))
+    {
+        runner.runTestsInCategory("Benchmarks");
+    }
+    else
+    {
+        runner.runTestsInCategory("OtoDecks");
+    }
+
+    int numFailures = 0;
+    for (int i = 0; i < runner.getNumResults(); ++i)
+    {
+        numFailures += runner.getResult(i)->failures;
+    }
+    return numFailures > 0 ? 1 : 0;
+}
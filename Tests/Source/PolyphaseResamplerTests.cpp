@@ -0,0 +1,157 @@
+/*
+  ==============================================================================
+    PolyphaseResamplerTests.cpp
+    Author:  Shamie
+  ==============================================================================
+*/
+
+#include "../../Source/PolyphaseResamplingAudioSource.h"
+#include <cmath>
+
+namespace
+{
+    const double sampleRate = 48000.0;
+    const int blockSize = 512;
+
+    /**Endless sine at a frequency given in cycles per input sample*/
+    class SineSource : public AudioSource
+    {
+    public:
+        SineSource(double _cyclesPerSample) : cyclesPerSample(_cyclesPerSample) {}
+
+        void prepareToPlay(int, double) override {}
+        void releaseResources() override {}
+        void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override
+        {
+            for (int i = 0; i < bufferToFill.numSamples; ++i)
+            {
+                const float sample = (float)std::sin(MathConstants<double>::twoPi * phase);
+                phase = std::fmod(phase + cyclesPerSample, 1.0);
+                for (int channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
+                {
+                    bufferToFill.buffer->setSample(channel, bufferToFill.startSample + i, sample);
+                }
+            }
+        }
+
+    private:
+        const double cyclesPerSample;
+        double phase = 0.0;
+    };
+
+    /**Level in decibels of a full scale sine at the given frequency after resampling,
+    measured once the filter has settled*/
+    double getOutputLevel(double cyclesPerSample, double ratio, PolyphaseResamplingAudioSource::Quality quality)
+    {
+        SineSource sine(cyclesPerSample);
+        PolyphaseResamplingAudioSource resampler(&sine, 2);
+        resampler.prepareToPlay(blockSize, sampleRate);
+        resampler.setQuality(quality);
+        resampler.setResamplingRatio(ratio);
+
+        AudioBuffer<float> buffer(2, blockSize);
+        double sumOfSquares = 0.0;
+        int numMeasured = 0;
+        for (int block = 0; block < 200; ++block)
+        {
+            resampler.getNextAudioBlock(AudioSourceChannelInfo(&buffer, 0, blockSize));
+            if (block >= 10)
+            {
+                const float* samples = buffer.getReadPointer(0);
+                for (int i = 0; i < blockSize; ++i)
+                {
+                    sumOfSquares += samples[i] * samples[i];
+                }
+                numMeasured += blockSize;
+            }
+        }
+        //a full scale sine has an RMS of 1 / sqrt(2)
+        return Decibels::gainToDecibels(std::sqrt(2.0 * sumOfSquares / numMeasured), -200.0);
+    }
+
+    const char* const qualityNames[] = { "draft", "normal", "high" };
+}
+
+//==============================================================================
+/**Tones that would fold back below Nyquist when a deck plays faster than real time
+must be filtered out, and tones well inside the passband left alone*/
+class PolyphaseResamplerTests : public UnitTest
+{
+public:
+    PolyphaseResamplerTests() : UnitTest("PolyphaseResamplingAudioSource", "OtoDecks") {}
+
+    void runTest() override
+    {
+        //least rejection of each quality, with a margin below what the filters measure
+        const double minRejection[] = { 45.0, 70.0, 88.0 };
+        const double ratios[] = { 1.25, 1.5, 2.0, 3.0, 4.0 };
+
+        for (int quality = PolyphaseResamplingAudioSource::draft; quality <= PolyphaseResamplingAudioSource::high; ++quality)
+        {
+            beginTest(String("Aliasing rejection, ") + qualityNames[quality]);
+            for (double ratio : ratios)
+            {
+                //30% above the output's Nyquist frequency once sped up, kept below the input's own
+                const double aliasing = jmin(0.49, 0.5 / ratio * 1.3);
+                const double level = getOutputLevel(aliasing, ratio, (PolyphaseResamplingAudioSource::Quality)quality);
+                expectLessThan(level, -minRejection[quality],
+                    "tone at " + String(aliasing, 3) + " cycles per sample, ratio " + String(ratio));
+            }
+
+            beginTest(String("Passband, ") + qualityNames[quality]);
+            for (double ratio : { 0.5, 1.0, 2.0, 4.0 })
+            {
+                //half the output's Nyquist frequency once resampled
+                const double level = getOutputLevel(0.25 / jmax(1.0, ratio), ratio, (PolyphaseResamplingAudioSource::Quality)quality);
+                expectWithinAbsoluteError(level, 0.0, 0.5, "ratio " + String(ratio));
+            }
+        }
+    }
+};
+
+static PolyphaseResamplerTests polyphaseResamplerTests;
+
+
+//==============================================================================
+/**Cost of each output sample for every quality, at real time and when sped up*/
+class PolyphaseResamplerBenchmark : public UnitTest
+{
+public:
+    PolyphaseResamplerBenchmark() : UnitTest("PolyphaseResamplingAudioSource benchmark", "Benchmarks") {}
+
+    void runTest() override
+    {
+        beginTest("Nanoseconds per output sample, stereo");
+
+        //ten seconds of output for each setting
+        const int numBlocks = (int)(10.0 * sampleRate / blockSize);
+
+        for (int quality = PolyphaseResamplingAudioSource::draft; quality <= PolyphaseResamplingAudioSource::high; ++quality)
+        {
+            for (double ratio : { 0.5, 1.0, 1.06, 2.0, 4.0 })
+            {
+                SineSource sine(0.01);
+                PolyphaseResamplingAudioSource resampler(&sine, 2);
+                resampler.prepareToPlay(blockSize, sampleRate);
+                resampler.setQuality((PolyphaseResamplingAudioSource::Quality)quality);
+                resampler.setResamplingRatio(ratio);
+                AudioBuffer<float> buffer(2, blockSize);
+
+                const int64 start = Time::getHighResolutionTicks();
+                for (int block = 0; block < numBlocks; ++block)
+                {
+                    resampler.getNextAudioBlock(AudioSourceChannelInfo(&buffer, 0, blockSize));
+                }
+                const double seconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+
+                //the sine source's own cost is included, as a deck's reader would be
+                const double nanoseconds = seconds * 1.0e9 / ((double)numBlocks * blockSize);
+                logMessage(String(qualityNames[quality]) + " at " + String(ratio, 2) + "x: "
+                    + String(nanoseconds, 1) + " ns");
+                expect(nanoseconds > 0.0);
+            }
+        }
+    }
+};
+
+static PolyphaseResamplerBenchmark polyphaseResamplerBenchmark;